@@ -12,6 +12,11 @@
 /** @brief Bit representing that the AI is full. */
 #define AI_STATUS_FULL              (1 << 31)
 #define AI_DACRATE_NTSC             (48681818)
+/**
+ * @brief AI DMA gets confused by a delayed internal carry if a buffer ends exactly
+ * at a multiple of this, so buffers must not end there.
+ */
+#define AI_DMA_BOUNDARY             (0x2000)
 
 typedef struct AI_registers_s
 {
@@ -0,0 +1,142 @@
+#ifndef KIVOS64_ARENA_H
+#define KIVOS64_ARENA_H
+
+#include "intdef.h"
+
+/** @brief Alignment of every arena allocation, enough for doublewords and the RDP's 8-byte requirements. */
+#define ARENA_ALIGN             8
+
+/** @brief Size of each of the two frame arenas, see #frame_arena_get. */
+#define FRAME_ARENA_SIZE        (32 * 1024)
+
+#ifdef KIVOS_DEBUG
+/** @brief Debug fill of freshly allocated arena memory, so reads of uninitialized data stand out. */
+#define ARENA_FILL_ALLOC        0xCD
+/** @brief Debug fill of released arena memory, so use after reset stands out. */
+#define ARENA_FILL_FREE         0xDD
+#endif
+
+/**
+ * @brief Linear arena allocator.
+ *
+ * Allocating bumps an offset into a fixed buffer. There is no per-allocation
+ * free, instead a mark taken by #arena_mark can be rolled back to, or the whole
+ * arena reset at once.
+ */
+typedef struct arena_s
+{
+    uint8_t* base;            // Start of the buffer.
+    uint32_t size;            // Size of the buffer in bytes.
+    uint32_t used;            // Bytes allocated so far, the offset of the next allocation.
+} arena_t;
+
+/**
+ * @brief Create an arena on the kernel heap.
+ *
+ * @param[in]  size     Size of the arena in bytes.
+ * @return              The arena, or NULL if it doesn't fit into the heap.
+ */
+arena_t* arena_create(uint32_t size);
+
+/**
+ * @brief Give an arena created by #arena_create back to the heap. Its allocations become invalid.
+ *
+ * @param[in]  arena    The arena to destroy, or NULL.
+ */
+void arena_destroy(arena_t* arena);
+
+/**
+ * @brief Get the arena for data that only lives until the frame after next is shown.
+ *
+ * There are two frame arenas in the user segment, so both the kernel and userspace
+ * can use them. #display_show switches between them and resets the one it switches
+ * to, after the RDP has finished the frame that last used it.
+ *
+ * @return              The current frame arena, or NULL if the user segment is full.
+ */
+arena_t* frame_arena_get(void);
+
+/**
+ * @brief Switch to the other frame arena and reset it. Called by #display_show.
+ *
+ * @param[in]  fence    RDP fence of the frame just shown, see #rdp_fence.
+ */
+void frame_arena_flip(uint32_t fence);
+
+/** @brief Fill arena memory with a debug pattern. Inline so that it works in userspace. */
+static inline void arena_fill(uint8_t* start, uint32_t size, uint8_t value)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        start[i] = value;
+    }
+}
+
+/**
+ * @brief Allocate from an arena.
+ *
+ * Inline so that userspace can use the frame arenas directly.
+ *
+ * @param[in]  arena    The arena to allocate from.
+ * @param[in]  size     Size in bytes.
+ * @return              #ARENA_ALIGN aligned memory, or NULL if the arena is full. Its contents are undefined.
+ */
+static inline void* arena_alloc(arena_t* arena, uint32_t size)
+{
+    uint32_t start = (arena->used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (start > arena->size || size > arena->size - start)
+    {
+        return NULL;
+    }
+
+    arena->used = start + size;
+
+#ifdef KIVOS_DEBUG
+    arena_fill(arena->base + start, size, ARENA_FILL_ALLOC);
+#endif
+
+    return arena->base + start;
+}
+
+/**
+ * @brief Remember how much of an arena is in use.
+ *
+ * @param[in]  arena    The arena.
+ * @return              Mark to pass to #arena_rollback.
+ */
+static inline uint32_t arena_mark(arena_t* arena)
+{
+    return arena->used;
+}
+
+/**
+ * @brief Release everything allocated from an arena since a mark was taken.
+ *
+ * @param[in]  arena    The arena.
+ * @param[in]  mark     Mark returned by #arena_mark, no later than the last rollback.
+ */
+static inline void arena_rollback(arena_t* arena, uint32_t mark)
+{
+    if (mark >= arena->used)
+    {
+        return;
+    }
+
+#ifdef KIVOS_DEBUG
+    arena_fill(arena->base + mark, arena->used - mark, ARENA_FILL_FREE);
+#endif
+
+    arena->used = mark;
+}
+
+/**
+ * @brief Release everything allocated from an arena.
+ *
+ * @param[in]  arena    The arena.
+ */
+static inline void arena_reset(arena_t* arena)
+{
+    arena_rollback(arena, 0);
+}
+
+#endif
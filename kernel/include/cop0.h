@@ -315,6 +315,21 @@
 #define C0_WRITE_WATCHLO(x) asm volatile("mtc0 %0,$18"::"r"(x))
 
 
+#define C0_TAGLO_PTAG       (0x0FFFFF00)    // TagLo: physical address bits 31 to 12 of the cache line.
+#define C0_TAGLO_DATA_VALID (1 << 7)        // TagLo: data cache line is valid.
+/**
+ * @brief Read the COP0 TagLo register.
+ *
+ * The Index Load Tag cache op puts the tag of a cache line here, so it can be
+ * checked which memory the line holds.
+ */
+#define C0_TAGLO() ({ \
+    uint32_t x; \
+    asm volatile("mfc0 %0,$28":"=r"(x)); \
+    x; \
+})
+
+
 /* Flag bits valid for COP0 EntryLo0/EntryLo1 registers */
 #define C0_ENTRYLO_GLOBAL      (1 << 0)       // EntryLo: mapping is global (all ASIDs)
 #define C0_ENTRYLO_VALID       (1 << 1)       // EntryLo: mapping is active (not disabled)
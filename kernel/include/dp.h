@@ -0,0 +1,62 @@
+/**
+ * @file dp.h
+ * @brief The Display Processor Command interface (or DPC) is one of multiple I/O interfaces in the RCP. It is the interface through which the CPU (or RSP) feeds command lists to the RDP.
+ */
+
+#ifndef KIVOS64_DP_H
+#define KIVOS64_DP_H
+
+#include "intdef.h"
+
+#define DP_REG_BASE                 (0xA4100000)
+
+// Read bits.
+#define DP_STATUS_XBUS              (1 << 0)      // Commands are fetched from RSP DMEM instead of RDRAM.
+#define DP_STATUS_FREEZE            (1 << 1)      // RDP is frozen.
+#define DP_STATUS_FLUSH             (1 << 2)      // RDP is flushed.
+#define DP_STATUS_START_GCLK        (1 << 3)      // GCLK is alive.
+#define DP_STATUS_TMEM_BUSY         (1 << 4)      // TMEM is being accessed.
+#define DP_STATUS_PIPE_BUSY         (1 << 5)      // Rasterization pipeline is busy.
+#define DP_STATUS_CMD_BUSY          (1 << 6)      // RDP is processing commands.
+#define DP_STATUS_CBUF_READY        (1 << 7)      // Command buffer is ready.
+#define DP_STATUS_DMA_BUSY          (1 << 8)      // Command DMA is in progress.
+#define DP_STATUS_END_PENDING       (1 << 9)      // A new end address was written but not yet taken.
+#define DP_STATUS_START_PENDING     (1 << 10)     // A new start address was written but not yet taken.
+// Write bits.
+#define DP_STATUS_CLR_XBUS          (1 << 0)      // Fetch commands from RDRAM.
+#define DP_STATUS_SET_XBUS          (1 << 1)      // Fetch commands from RSP DMEM.
+#define DP_STATUS_CLR_FREEZE        (1 << 2)      // Unfreeze RDP.
+#define DP_STATUS_SET_FREEZE        (1 << 3)      // Freeze RDP.
+#define DP_STATUS_CLR_FLUSH         (1 << 4)      // Unflush RDP.
+#define DP_STATUS_SET_FLUSH         (1 << 5)      // Flush RDP.
+#define DP_STATUS_CLR_TMEM_CTR      (1 << 6)      // Clear TMEM counter.
+#define DP_STATUS_CLR_PIPE_CTR      (1 << 7)      // Clear pipe counter.
+#define DP_STATUS_CLR_CMD_CTR       (1 << 8)      // Clear command counter.
+#define DP_STATUS_CLR_CLOCK_CTR     (1 << 9)      // Clear clock counter.
+
+typedef struct DP_registers_s
+{
+    /** @brief RDRAM address of the first command to process, must be 8 byte aligned. */
+    uint32_t start;
+    /**
+     * @brief RDRAM address one past the last command to process, must be 8 byte aligned.
+     * Writing to this register will start processing commands.
+     */
+    uint32_t end;
+    /** @brief RDRAM address of the command currently being processed. */
+    uint32_t current;
+    /** @brief Status of the RDP. Writing to this register changes its mode. */
+    uint32_t status;
+    /** @brief Clock counter. */
+    uint32_t clock;
+    /** @brief Buffer busy counter. */
+    uint32_t bufbusy;
+    /** @brief Pipe busy counter. */
+    uint32_t pipebusy;
+    /** @brief TMEM load counter. */
+    uint32_t tmem;
+} DP_registers_t;
+
+extern volatile DP_registers_t* const DP_regs;
+
+#endif
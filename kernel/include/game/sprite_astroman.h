@@ -1,4 +1,4 @@
-unsigned char sprite_astroman_data[] = {
+unsigned char sprite_astroman_data[] __attribute__((aligned(16))) = {
   0x00, 0x00,
   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x71,
   0xbb, 0xff, 0x28, 0x71, 0xba, 0xff, 0x28, 0x71, 0xbb, 0xff, 0x28, 0x71,
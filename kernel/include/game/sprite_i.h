@@ -1,4 +1,4 @@
-unsigned char sprite_i_data[] = {
+unsigned char sprite_i_data[] __attribute__((aligned(16))) = {
   0xda, 0xad,
   0x03, 0xff, 0xda, 0xad, 0x03, 0xff, 0xda, 0xad, 0x03, 0xff, 0xda, 0xad,
   0x03, 0xff, 0xda, 0xad, 0x03, 0xff, 0xda, 0xad, 0x03, 0xff, 0xda, 0xad,
@@ -7,9 +7,40 @@
  * @brief Create a uint32_t representing color from R,G,B,A components in the RGBA32 range (0-255).
  */
 #define RGBA32(r,g,b,a) ({ \
-    (uint32_t) ((((uint8_t) r) << 24) | (((uint8_t) g) << 16) | (((uint8_t) b) << 8) | ((uint8_t) a)); \
+    (uint32_t) ((((uint32_t) (uint8_t) (r)) << 24) | (((uint32_t) (uint8_t) (g)) << 16) | (((uint32_t) (uint8_t) (b)) << 8) | ((uint8_t) (a))); \
 })
 
+/** 
+ * @brief Create a uint16_t representing color from R,G,B,A components in the RGBA32 range (0-255).
+ *
+ * The result is in RGBA5551 format: 5 bits per color channel and a 1-bit alpha set for alpha >= 128.
+ */
+#define RGBA16(r,g,b,a) ({ \
+    (uint16_t) (((((uint8_t) (r)) >> 3) << 11) | ((((uint8_t) (g)) >> 3) << 6) | ((((uint8_t) (b)) >> 3) << 1) | (((uint8_t) (a)) >> 7)); \
+})
+
+/** @brief Convert RGBA32 color to RGBA5551. */
+static inline uint16_t color_to_rgba16(uint32_t color)
+{
+    return ((color >> 16) & 0xF800) | ((color >> 13) & 0x07C0) | ((color >> 10) & 0x003E) | ((color >> 7) & 0x1);
+}
+
+/**
+ * @brief Pixel formats of a surface.
+ */
+typedef enum
+{
+    FMT_RGBA32,     // 32-bit RGBA8888.
+    FMT_RGBA16,     // 16-bit RGBA5551.
+    FMT_CI8,        // 8-bit index into a 256 entry palette.
+    FMT_CI4         // 4-bit index into a 16 entry palette, two pixels per byte with the first one in the high nibble.
+} surface_format_t;
+
+/** @brief Surface flag: color channels are already multiplied by alpha. */
+#define SURFACE_FLAGS_PREMULTIPLIED     (1 << 0)
+/** @brief Surface flag: buffer is accessed through the data cache and must be written back before the hardware reads it. */
+#define SURFACE_FLAGS_CACHED            (1 << 1)
+
 /**
  * @brief This structure holds the basic information about a buffer used to hold graphics.
  */
@@ -17,9 +48,126 @@ typedef struct surface_s
 {
     uint16_t width;       // Width in pixels.
     uint16_t height;      // Height in pixels.
-    uint32_t* buffer;     // Buffer pointer.
+    void* buffer;         // Buffer pointer.
+    uint32_t format;      // Pixel format (surface_format_t).
+    uint32_t flags;       // Surface flags (SURFACE_FLAGS_*).
+    const uint32_t* palette;  // RGBA32 palette of color-indexed formats, NULL otherwise.
 } surface_t;
 
+/**
+ * @brief Size of a single pixel of the given format in bytes.
+ *
+ * @note Only meaningful for the RGBA formats, use #surface_buffer_size for color-indexed ones.
+ */
+static inline int surface_bytes_per_pixel(surface_format_t format)
+{
+    return (format == FMT_RGBA16) ? 2 : 4;
+}
+
+/**
+ * @brief Size of the pixel buffer of a surface in bytes.
+ *
+ * Rows are not padded, so a CI4 surface with odd width starts every other row mid-byte.
+ */
+static inline uint32_t surface_buffer_size(surface_format_t format, int width, int height)
+{
+    switch (format)
+    {
+        case FMT_CI8:
+            return width * height;
+        case FMT_CI4:
+            return (width * height + 1) / 2;
+        default:
+            return width * height * surface_bytes_per_pixel(format);
+    }
+}
+
+/**
+ * @brief Span of a run-length encoded sprite row.
+ *
+ * Skip #skip transparent pixels, then copy #opaque pixels, then blend #blend pixels.
+ */
+typedef struct sprite_rle_span_s
+{
+    uint16_t skip;        // Number of fully transparent pixels.
+    uint16_t opaque;      // Number of fully opaque pixels.
+    uint16_t blend;       // Number of translucent pixels.
+} sprite_rle_span_t;
+
+/**
+ * @brief Run-length encoded sprite as produced by tools/spriteconv (--format rle).
+ *
+ * Each row starts at #row_offsets[row] bytes from the start of the sprite, is 4-byte aligned
+ * and consists of a uint16_t span count, the #sprite_rle_span_t spans and, aligned to 4 bytes,
+ * the RGBA32 pixels of all opaque and translucent runs of the row in order.
+ */
+typedef struct sprite_rle_s
+{
+    uint16_t width;           // Width in pixels.
+    uint16_t height;          // Height in pixels.
+    uint32_t flags;           // Surface flags (SURFACE_FLAGS_*).
+    uint32_t row_offsets[];   // Byte offset of each row.
+} sprite_rle_t;
+
+/** @brief Pack a pair of signed 16-bit coordinates into one syscall argument. */
+#define GRAPHICS_PACK_XY(x, y)      ((((uint32_t) (y)) << 16) | (((uint32_t) (x)) & 0xFFFF))
+/** @brief Unpack the x coordinate of #GRAPHICS_PACK_XY. */
+#define GRAPHICS_UNPACK_X(xy)       ((int) (int16_t) ((xy) & 0xFFFF))
+/** @brief Unpack the y coordinate of #GRAPHICS_PACK_XY. */
+#define GRAPHICS_UNPACK_Y(xy)       ((int) (int16_t) ((xy) >> 16))
+
+/**
+ * @brief Types of batched drawing commands, see #graphics_cmd_t.
+ */
+typedef enum
+{
+    GRAPHICS_CMD_FILL,                  // #graphics_fill with #color.
+    GRAPHICS_CMD_RESTORE_BACKGROUND,    // #graphics_restore_background with #color.
+    GRAPHICS_CMD_FILL_RECT,             // #graphics_fill_rect with #x, #y, #width, #height and #color.
+    GRAPHICS_CMD_DRAW_SURFACE,          // #graphics_draw_surface of #src at #x, #y.
+    GRAPHICS_CMD_DRAW_SURFACE_ALPHA,    // #graphics_draw_surface_alpha of #src at #x, #y.
+    GRAPHICS_CMD_DRAW_SPRITE_RLE,       // #graphics_draw_sprite_rle of #sprite at #x, #y.
+    GRAPHICS_CMD_DRAW_LINE,             // #graphics_draw_line from #x, #y to #x1, #y1 with #color.
+    GRAPHICS_CMD_DRAW_RECT,             // #graphics_draw_rect with #x, #y, #width, #height and #color.
+    GRAPHICS_CMD_DRAW_CIRCLE,           // #graphics_draw_circle around #x, #y with #radius and #color.
+    GRAPHICS_CMD_FILL_CIRCLE            // #graphics_fill_circle around #x, #y with #radius and #color.
+} graphics_cmd_type_t;
+
+/** @brief Command flag: blend shapes with the alpha of their color (the *_alpha variant). */
+#define GRAPHICS_CMD_FLAGS_ALPHA        (1 << 0)
+
+/**
+ * @brief A single drawing command executed by #graphics_submit.
+ */
+typedef struct graphics_cmd_s
+{
+    uint16_t type;            // Command type (graphics_cmd_type_t).
+    int16_t x;                // X coordinate.
+    int16_t y;                // Y coordinate.
+    union
+    {
+        struct
+        {
+            uint16_t width;   // Width of the rectangle, if any.
+            uint16_t height;  // Height of the rectangle, if any.
+        };
+        struct
+        {
+            int16_t x1;       // X coordinate of the end point of lines.
+            int16_t y1;       // Y coordinate of the end point of lines.
+        };
+        uint16_t radius;      // Radius of circles.
+    };
+    uint16_t flags;           // Command flags (GRAPHICS_CMD_FLAGS_*).
+    surface_t* dst;           // The surface to draw to.
+    union
+    {
+        uint32_t color;               // The 32-bit RGBA color of fills.
+        surface_t* src;               // The surface to draw from.
+        const sprite_rle_t* sprite;   // The sprite to draw.
+    };
+} graphics_cmd_t;
+
 /**
  * @brief
  * 
@@ -28,44 +176,133 @@ typedef struct surface_s
  *
  * @param[in]  width    Width in pixels.
  * @param[in]  height   Height in pixels.
+ * @param[in]  format   Pixel format. Color-indexed surfaces need their palette set before drawing them.
  * @return              The initialized surface.
  */
-surface_t surface_alloc(uint16_t width, uint16_t height);
+surface_t surface_alloc(uint16_t width, uint16_t height, surface_format_t format);
+
+/**
+ * @brief Allocate a new surface and decompress its pixels from a compressed blob.
+ *
+ * Lets sprite data stay compressed until it's needed. The surface must be freed via
+ * #surface_free when it is not needed anymore.
+ *
+ * @param[in]  width    Width in pixels.
+ * @param[in]  height   Height in pixels.
+ * @param[in]  format   Pixel format.
+ * @param[in]  blob     Compressed pixels as produced by tools/spriteconv (--compress).
+ * @param[in]  blob_size Size of the blob in bytes.
+ * @return              The initialized surface, its buffer is NULL if the blob doesn't match.
+ */
+surface_t surface_load_lz4(uint16_t width, uint16_t height, surface_format_t format, const void* blob, uint32_t blob_size);
 
 /**
  * @brief
  * 
  * This function should be called after a surface allocated via #surface_alloc is not
- * needed anymore. 
+ * needed anymore. Its buffer goes back to the heap, so surfaces pointing at static
+ * data must not be passed here.
  * 
  * @param[in]  surface   The surface to free.
  */
 void surface_free(surface_t surface);
 
+/**
+ * @brief Switch a surface between cached (KSEG0) and uncached (KSEG1) access.
+ *
+ * Cached surfaces make read-modify-write loops like alpha blending much cheaper, but
+ * their contents only reach RDRAM once written back. The RDP and display code take
+ * care of that for surfaces with #SURFACE_FLAGS_CACHED set.
+ *
+ * @param[in]  surface  The surface to change.
+ * @param[in]  cached   Whether the surface should be cached.
+ */
+void surface_set_cached(surface_t* surface, bool cached);
+
+/**
+ * @brief Convert a surface to premultiplied alpha in place.
+ *
+ * Premultiplied surfaces are blended with a single multiply per channel
+ * by #graphics_draw_surface_alpha. Does nothing if the surface is already premultiplied.
+ *
+ * @note Only RGBA32 surfaces are converted, RGBA16 has just a 1-bit alpha and palettes
+ * of color-indexed surfaces are read-only (premultiply them with spriteconv -p instead).
+ *
+ * @param[in]  surface   The surface to convert.
+ */
+void surface_premultiply(surface_t* surface);
+
 typedef enum
 {
     FILTER_NONE,
     FILTER_RESAMPLE
 } filter_t;
 
+/** @brief Maximum number of display framebuffers. */
+#define DISPLAY_MAX_BUFFERS     (4)
+
+typedef enum
+{
+    PRESENT_VSYNC,      // Every frame is shown in order, switching only at vblank.
+    PRESENT_LATEST      // Frames are shown as soon as they're done, tearing allowed.
+} present_mode_t;
+
 /**
- * @brief Initializes the display module, preparing a double-buffered display
+ * @brief Frame pacing counters of the display, reset by #display_init.
+ */
+typedef struct display_stats_s
+{
+    uint32_t present_mode;    // Present mode the counters were collected under (present_mode_t).
+    uint32_t presented;       // Frames passed to #display_show.
+    uint32_t dropped;         // Frames replaced before they were scanned out whole.
+    uint32_t repeated;        // Vblanks that showed the previous frame again.
+    uint32_t vblanks;         // Vblank interrupts.
+    uint32_t acquired;        // Framebuffers handed out by #display_get and #display_try_get.
+    uint32_t acquire_wait;    // COP0 Count cycles #display_get spent waiting for a free buffer. Wraps like Count.
+    uint32_t acquire_wait_max;    // Longest single wait of #display_get in COP0 Count cycles.
+} display_stats_t;
+
+/**
+ * @brief Initializes the display module, preparing a multi-buffered display
  * at a given resolution for drawing.
  * 
- * @param[in] width     The display width.
- * @param[in] height    The display height.
- * @param[in] filter    The filter settings that should be used when the display
+ * @param[in] width         The display width.
+ * @param[in] height        The display height.
+ * @param[in] format        The pixel format of the display. With FMT_RGBA16, the width
+ * must be a multiple of 4.
+ * @param[in] num_buffers   Number of framebuffers, 2 to #DISPLAY_MAX_BUFFERS. A third buffer
+ * lets the CPU keep drawing when a frame runs a little over the vblank interval.
+ * @param[in] present_mode  How finished frames are put on screen.
+ * @param[in] filter        The filter settings that should be used when the display
  * is shown on screen by the VI.
  */
-void display_init(int width, int height, filter_t filter);
+void display_init(int width, int height, surface_format_t format, int num_buffers, present_mode_t present_mode, filter_t filter);
+
+/**
+ * @brief Switch all display surfaces between cached and uncached rendering.
+ *
+ * With caching enabled, #display_show writes the surface back to RDRAM before
+ * the VI gets to scan it out.
+ *
+ * @param[in] cached    Whether display surfaces should be cached.
+ */
+void display_set_cached(bool cached);
 
 /**
- * @brief Acquire a surface instance of the display that's available to draw to.
+ * @brief Acquire a surface instance of the display that's available to draw to,
+ * waiting for one to be freed if needed.
  * 
  * @return surface_t*   Pointer to surface to draw to. 
  */
 surface_t* display_get(void);
 
+/**
+ * @brief Acquire a surface instance of the display if one is available right now.
+ *
+ * @return surface_t*   Pointer to surface to draw to, or NULL if all are in use.
+ */
+surface_t* display_try_get(void);
+
 /**
  * @brief Returns an acquired display surface and marks it to be displayed on screen
  * at the next available vblank.
@@ -75,6 +312,67 @@ surface_t* display_get(void);
  */
 void display_show(surface_t* surface);
 
+/**
+ * @brief Read the frame pacing counters of the display.
+ *
+ * @param[out] stats        Receives the counters.
+ */
+void display_get_stats(display_stats_t* stats);
+
+/**
+ * @brief Periodically write the frame pacing counters to ISViewer.
+ *
+ * Every interval frames, #display_show prints how the counters changed since the last dump.
+ * ISViewer writes are slow, so this is meant for tracking down pacing problems only.
+ *
+ * @param[in]  interval     Number of presented frames between dumps, 0 to disable.
+ */
+void display_set_stats_dump(int interval);
+
+/** @brief Maximum number of rectangles #display_take_dirty writes. */
+#define DISPLAY_MAX_DIRTY_RECTS     (32)
+
+/**
+ * @brief Rectangle of a display surface that has been drawn to. The end coordinates are exclusive.
+ */
+typedef struct display_rect_s
+{
+    int16_t x0;
+    int16_t y0;
+    int16_t x1;
+    int16_t y1;
+} display_rect_t;
+
+/**
+ * @brief Record that a rectangle of a display surface has been drawn to.
+ *
+ * Overlapping rectangles are merged. Does nothing for surfaces that don't belong to the display.
+ *
+ * @param[in]  surface  The surface drawn to.
+ * @param[in]  x0       Left edge, inclusive.
+ * @param[in]  y0       Top edge, inclusive.
+ * @param[in]  x1       Right edge, exclusive.
+ * @param[in]  y1       Bottom edge, exclusive.
+ */
+void display_mark_dirty(surface_t* surface, int x0, int y0, int x1, int y1);
+
+/**
+ * @brief Record that a whole display surface has been drawn to.
+ *
+ * @param[in]  surface  The surface drawn to.
+ */
+void display_mark_dirty_all(surface_t* surface);
+
+/**
+ * @brief Fetch and reset the dirty rectangles of a display surface.
+ *
+ * @param[in]  surface  The surface to query.
+ * @param[out] rects    Array of at least #DISPLAY_MAX_DIRTY_RECTS rectangles.
+ * @return              Number of rectangles written, or -1 if the whole surface is dirty
+ * or the surface doesn't belong to the display.
+ */
+int display_take_dirty(surface_t* surface, display_rect_t* rects);
+
 /**
  * @brief Draw a pixel to a given surface.
  *
@@ -112,6 +410,94 @@ void graphics_draw_pixel_alpha(surface_t* surface, int x, int y, uint32_t color)
  */
 void graphics_fill(surface_t* surface, uint32_t color);
 
+/**
+ * @brief Fill a rectangle with a solid color while performing clipping.
+ *
+ * @param[in]  surface  The surface to draw to.
+ * @param[in]  x        The x coordinate of the top left corner.
+ * @param[in]  y        The y coordinate of the top left corner.
+ * @param[in]  width    Width of the rectangle.
+ * @param[in]  height   Height of the rectangle.
+ * @param[in]  color    The 32-bit RGBA color to draw to the screen.
+ */
+void graphics_fill_rect(surface_t* surface, int x, int y, int width, int height, uint32_t color);
+
+/**
+ * @brief Refill the parts of a display surface that were drawn to the last time it was used.
+ *
+ * Each display surface remembers the rectangles drawn to it since its background was last restored,
+ * so a mostly static scene only pays for the area its sprites covered. Surfaces that don't belong to
+ * the display are filled whole, same as #graphics_fill.
+ *
+ * @param[in]  surface  The surface to draw to.
+ * @param[in]  color    The 32-bit RGBA background color.
+ */
+void graphics_restore_background(surface_t* surface, uint32_t color);
+
+/**
+ * @brief Visible part of a rectangle drawn to a surface, relative to the rectangle's top left corner.
+ */
+typedef struct clip_area_s
+{
+    int x_start;
+    int y_start;
+    int x_end;
+    int y_end;
+} clip_area_t;
+
+/**
+ * @brief Clip a rectangle placed at x/y against the bounds of a surface.
+ *
+ * @note The rectangle must overlap the surface, check that first.
+ *
+ * @param[in]  dst      The surface drawn to.
+ * @param[in]  x        The x coordinate of the rectangle.
+ * @param[in]  y        The y coordinate of the rectangle.
+ * @param[in]  width    Width of the rectangle.
+ * @param[in]  height   Height of the rectangle.
+ * @return              The visible area, in coordinates relative to x/y.
+ */
+clip_area_t graphics_clip(surface_t* dst, int x, int y, int width, int height);
+
+/**
+ * @brief Copy a run of pixels from one surface to another, converting between formats if needed.
+ *
+ * @note No clipping and no synchronization with the RDP, this is a building block for other drawing code.
+ *
+ * @param[in]  dst        The surface to draw to.
+ * @param[in]  dst_index  Index of the first destination pixel.
+ * @param[in]  src        The surface to draw from.
+ * @param[in]  src_index  Index of the first source pixel.
+ * @param[in]  count      Number of pixels to copy.
+ */
+void graphics_copy_pixels(surface_t* dst, int dst_index, surface_t* src, int src_index, int count);
+
+/**
+ * @brief Fill a horizontal run of pixels with a solid color.
+ *
+ * @note No clipping and no synchronization with the RDP, this is a building block for other drawing code.
+ *
+ * @param[in]  surface  The surface to draw to.
+ * @param[in]  x0       First pixel of the run.
+ * @param[in]  x1       One past the last pixel of the run.
+ * @param[in]  y        Row of the run.
+ * @param[in]  color    The 32-bit RGBA color to draw.
+ */
+void graphics_fill_span(surface_t* surface, int x0, int x1, int y, uint32_t color);
+
+/**
+ * @brief Alpha-blend a solid color over a horizontal run of pixels.
+ *
+ * @note No clipping and no synchronization with the RDP, this is a building block for other drawing code.
+ *
+ * @param[in]  surface  The surface to draw to.
+ * @param[in]  x0       First pixel of the run.
+ * @param[in]  x1       One past the last pixel of the run.
+ * @param[in]  y        Row of the run.
+ * @param[in]  color    The 32-bit RGBA color to blend.
+ */
+void graphics_blend_span(surface_t* surface, int x0, int x1, int y, uint32_t color);
+
 /**
  * @brief Draws surface-to-surface while performing clipping.
  * 
@@ -125,6 +511,9 @@ void graphics_draw_surface(surface_t* dst, int x, int y, surface_t* src);
 /**
  * @brief Draws surface-to-surface while performing clipping and alphablending.
  * Useful for drawing sprites.
+ *
+ * Color-indexed sources are expanded through their palette while drawing.
+ * The destination must be an RGBA surface.
  * 
  * @param[in]  dst      The surface to draw to.
  * @param[in]  x        The x coordinate of the pixel.
@@ -133,4 +522,109 @@ void graphics_draw_surface(surface_t* dst, int x, int y, surface_t* src);
  */
 void graphics_draw_surface_alpha(surface_t* dst, int x, int y, surface_t* src);
 
+/**
+ * @brief Draws a rectangular region of a surface while performing clipping and alphablending.
+ * Useful for drawing frames out of a sprite atlas.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x        The x coordinate of the region on dst.
+ * @param[in]  y        The y coordinate of the region on dst.
+ * @param[in]  src      The surface to draw from.
+ * @param[in]  src_x    The x coordinate of the region on src.
+ * @param[in]  src_y    The y coordinate of the region on src.
+ * @param[in]  width    Width of the region. Parts outside of src are not drawn.
+ * @param[in]  height   Height of the region. Parts outside of src are not drawn.
+ */
+void graphics_draw_surface_region_alpha(surface_t* dst, int x, int y, surface_t* src, int src_x, int src_y, int width, int height);
+
+/** @brief Mirror the source region horizontally. */
+#define BLIT_FLIP_X     (1 << 0)
+/** @brief Mirror the source region vertically. */
+#define BLIT_FLIP_Y     (1 << 1)
+
+/**
+ * @brief How #graphics_draw_surface_transformed maps the source onto the destination.
+ *
+ * The pivot is scaled, flipped and rotated around and lands on the x/y passed to the draw.
+ * With a zero pivot, no rotation and unit scales the result is the same as #graphics_draw_surface_region_alpha.
+ */
+typedef struct blit_params_s
+{
+    /**
+     * @brief Region of the source surface to draw, nothing is drawn if it starts outside of it.
+     * Zero width or height means the rest of the surface, larger ones are clamped to it.
+     */
+    int16_t src_x;
+    int16_t src_y;
+    uint16_t width;
+    uint16_t height;
+    /** @brief Pivot point, relative to the region. */
+    int16_t pivot_x;
+    int16_t pivot_y;
+    /** @brief Scale factors, must not be zero. */
+    float scale_x;
+    float scale_y;
+    /** @brief Clockwise rotation in radians. */
+    float angle;
+    /** @brief BLIT_FLIP_X and BLIT_FLIP_Y. */
+    uint32_t flags;
+} blit_params_t;
+
+/**
+ * @brief Draws a scaled, rotated and/or flipped surface region while performing clipping and alphablending.
+ *
+ * Alpha is handled like in #graphics_draw_surface_alpha. Sampling is nearest-neighbour.
+ * Integer scales without rotation take a fast path that fills runs of duplicated pixels.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x        The x coordinate of the pivot on dst.
+ * @param[in]  y        The y coordinate of the pivot on dst.
+ * @param[in]  src      The surface to draw from.
+ * @param[in]  params   Source region and transformation.
+ */
+void graphics_draw_surface_transformed(surface_t* dst, int x, int y, surface_t* src, const blit_params_t* params);
+
+/**
+ * @brief Draws a run-length encoded sprite while performing clipping and alphablending.
+ *
+ * Transparent runs are skipped without touching memory and opaque runs are block copied,
+ * so this is faster than #graphics_draw_surface_alpha for sprites with few translucent pixels.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x        The x coordinate of the sprite.
+ * @param[in]  y        The y coordinate of the sprite.
+ * @param[in]  sprite   The sprite to draw.
+ */
+void graphics_draw_sprite_rle(surface_t* dst, int x, int y, const sprite_rle_t* sprite);
+
+/** @brief Width of a character drawn by #graphics_draw_text in pixels. */
+#define FONT_WIDTH      (8)
+/** @brief Height of a character drawn by #graphics_draw_text in pixels. */
+#define FONT_HEIGHT     (8)
+
+/**
+ * @brief Draws text with the built-in 8x8 monospace font while performing clipping.
+ *
+ * Only the glyph pixels are drawn, the background shows through. A newline continues at x
+ * on the next line, characters outside of printable ASCII are drawn as '?'.
+ * Useful for on-screen statistics.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x        The x coordinate of the first character.
+ * @param[in]  y        The y coordinate of the first character.
+ * @param[in]  text     Zero-terminated string.
+ * @param[in]  color    The 32-bit RGBA color of the text, blended if not opaque.
+ */
+void graphics_draw_text(surface_t* dst, int x, int y, const char* text, uint32_t color);
+
+/**
+ * @brief Execute a batch of drawing commands in order.
+ *
+ * Lets user code draw a whole frame with a single syscall instead of one per sprite.
+ *
+ * @param[in]  cmds     The commands to execute.
+ * @param[in]  count    Number of commands.
+ */
+void graphics_submit(const graphics_cmd_t* cmds, int count);
+
 #endif
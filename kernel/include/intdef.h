@@ -34,6 +34,15 @@ typedef __UINT32_TYPE__ uint32_t;
 typedef __UINT64_TYPE__ uint64_t;
 #endif
 
+#ifdef __UINTPTR_TYPE__
+typedef __UINTPTR_TYPE__ uintptr_t;
+#endif
+
+#ifdef KIVOS_HOST
+// Host builds of the kernel sources share size_t with the C library.
+typedef __SIZE_TYPE__ size_t;
+#else
 typedef uint32_t size_t;
+#endif
 
 #endif
\ No newline at end of file
@@ -10,6 +10,24 @@ typedef enum
     SYSCALL_DISPLAY_INIT,
     SYSCALL_DISPLAY_GET,
     SYSCALL_DISPLAY_SHOW,
+    SYSCALL_GRAPHICS_DRAW_SPRITE_RLE,
+    SYSCALL_GRAPHICS_RESTORE_BACKGROUND,
+    SYSCALL_GRAPHICS_SUBMIT,
+    SYSCALL_DISPLAY_SET_CACHED,
+    SYSCALL_DISPLAY_TRY_GET,
+    SYSCALL_TILEMAP_DRAW,
+    SYSCALL_SPRITE_BATCH_DRAW,
+    SYSCALL_GRAPHICS_DRAW_LINE,
+    SYSCALL_GRAPHICS_DRAW_RECT,
+    SYSCALL_GRAPHICS_FILL_RECT,
+    SYSCALL_GRAPHICS_DRAW_CIRCLE,
+    SYSCALL_GRAPHICS_FILL_CIRCLE,
+    SYSCALL_GRAPHICS_DRAW_SURFACE_TRANSFORMED,
+    SYSCALL_GRAPHICS_DRAW_TEXT,
+    SYSCALL_DISPLAY_GET_STATS,
+    SYSCALL_DISPLAY_SET_STATS_DUMP,
+    SYSCALL_POOL_CREATE,
+    SYSCALL_FRAME_ARENA_GET,
     SYSCALL_TEST = 42
 } syscall_t;
 
@@ -23,4 +41,8 @@ void interrupt_set_SI(bool active);
 
 void interrupt_set_VI(bool active, uint32_t line);
 
+void interrupt_set_DP(bool active);
+
+void interrupt_set_SP(bool active);
+
 #endif
@@ -0,0 +1,56 @@
+#ifndef KIVOS64_LZ4_H
+#define KIVOS64_LZ4_H
+
+#include "intdef.h"
+
+/** @brief Magic number at the start of a compressed blob ("LZ4K"). */
+#define LZ4_MAGIC               (0x4C5A344B)
+
+/**
+ * @brief Compressed blob as produced by tools/spriteconv (--compress).
+ *
+ * The header is followed by a standard LZ4 block: sequences of a token byte
+ * (literal length in the high nibble, match length - 4 in the low nibble),
+ * optional length extension bytes, the literals, and a 16-bit little endian
+ * match offset. The last sequence has literals only.
+ */
+typedef struct lz4_blob_s
+{
+    uint32_t magic;           // #LZ4_MAGIC.
+    uint32_t size;            // Size of the decompressed data in bytes.
+    uint8_t data[];           // LZ4 block.
+} lz4_blob_t;
+
+/**
+ * @brief Get the decompressed size of a blob.
+ *
+ * @param[in]  blob     The compressed blob.
+ * @return              Size in bytes, or 0 if blob is not a compressed blob.
+ */
+uint32_t lz4_decompressed_size(const void* blob);
+
+/**
+ * @brief Decompress a blob.
+ *
+ * Corrupt data never makes the decompressor write outside of dst.
+ *
+ * @param[out] dst      Buffer to receive the decompressed data. Should be cached memory.
+ * @param[in]  dst_size Size of dst in bytes.
+ * @param[in]  blob     The compressed blob, 4-byte aligned.
+ * @param[in]  blob_size Size of the blob in bytes.
+ * @return              Number of bytes written, or -1 if the blob is corrupt or doesn't fit.
+ */
+int lz4_decompress(void* dst, uint32_t dst_size, const void* blob, uint32_t blob_size);
+
+/**
+ * @brief Measure decompression throughput and print it to ISViewer.
+ *
+ * @param[out] dst      Buffer large enough for the decompressed data.
+ * @param[in]  blob     The compressed blob.
+ * @param[in]  blob_size Size of the blob in bytes.
+ * @param[in]  iterations How many times to decompress the blob.
+ * @return              Throughput in MB/s of decompressed data.
+ */
+float lz4_benchmark(void* dst, const void* blob, uint32_t blob_size, int iterations);
+
+#endif
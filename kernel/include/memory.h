@@ -5,8 +5,84 @@
 
 void* malloc(size_t numbytes);
 
+/**
+ * @brief Allocate memory accessed through KSEG1, for buffers shared with the hardware.
+ *
+ * The block is rounded up to whole data cache lines, and any lines of it still in
+ * the cache are written back and invalidated first. The memory must then only be
+ * accessed through the returned address, debug builds check that on #free.
+ *
+ * @param[in]  numbytes Size in bytes.
+ * @return              KSEG1 address of the memory, or NULL if it doesn't fit into the heap.
+ */
 void* malloc_uncached(size_t numbytes);
 
+/**
+ * @brief Allocate memory at a given alignment.
+ *
+ * Like every heap allocation, the buffer starts and ends on data cache lines and
+ * shares them with nothing else.
+ *
+ * @param[in]  numbytes Size in bytes.
+ * @param[in]  align    Alignment in bytes, a power of two. Anything up to 16 is always met.
+ * @return              The memory, or NULL if it doesn't fit into the heap. Give it back with #free.
+ */
+void* malloc_aligned(size_t numbytes, uint32_t align);
+
+/**
+ * @brief Allocate a buffer for DMA.
+ *
+ * The buffer's cache lines are written back and invalidated, so it can be accessed
+ * through KSEG1 or handed to the hardware right away. Some hardware can't handle
+ * buffers ending at certain addresses, like the AI at 8 KB boundaries (see #AI_DMA_BOUNDARY).
+ *
+ * @param[in]  numbytes         Size in bytes.
+ * @param[in]  align            Alignment in bytes, a power of two. Anything up to 16 is always met.
+ * @param[in]  avoid_boundary   Power of two the end of the buffer must not be a multiple of, or 0.
+ * @return                      KSEG0 address of the buffer, or NULL if it doesn't fit into the heap.
+ */
+void* malloc_dma(size_t numbytes, uint32_t align, uint32_t avoid_boundary);
+
+/**
+ * @brief Return memory to the heap.
+ *
+ * Neighbouring free blocks are merged right away, so memory freed after a level
+ * is available for large allocations again.
+ *
+ * @param[in]  first_byte   Pointer from any of the malloc functions, or NULL.
+ */
+void free(void* first_byte);
+
+/**
+ * @brief Reserve memory in the user segment, after the user program.
+ *
+ * For objects the kernel sets up for userspace to work on directly. The memory
+ * can't be given back.
+ *
+ * @param[in]  size     Size in bytes.
+ * @return              16-byte aligned user segment address, or NULL if the segment is full.
+ */
+void* user_region_alloc(uint32_t size);
+
+/** @brief Heap usage, see #malloc_get_stats. Sizes include block headers. */
+typedef struct heap_stats_s
+{
+    uint32_t total;           // Bytes managed by the heap.
+    uint32_t used_bytes;      // Bytes in allocated blocks.
+    uint32_t free_bytes;      // Bytes in free blocks.
+    uint32_t largest_free;    // Largest allocation that can currently succeed.
+    uint32_t used_blocks;     // Number of allocated blocks.
+    uint32_t free_blocks;     // Number of free blocks, more than one means the free memory is fragmented.
+} heap_stats_t;
+
+/**
+ * @brief Walk the heap to check its consistency and collect usage statistics.
+ *
+ * @param[out] stats    Filled with the heap usage.
+ * @return              False if the heap is corrupted, the statistics are incomplete then.
+ */
+bool malloc_get_stats(heap_stats_t* stats);
+
 void* memcpy(void* dest, const void* src, size_t len);
 
 void* memset(void* dst, int value, size_t len);
@@ -0,0 +1,96 @@
+#ifndef KIVOS64_POOL_H
+#define KIVOS64_POOL_H
+
+#include "intdef.h"
+
+/** @brief Pool flag: objects are accessed through KSEG1, for memory other hardware reads. Kernel pools only. */
+#define POOL_FLAGS_UNCACHED     (1 << 0)
+/** @brief Pool flag: every object starts on its own data cache line. */
+#define POOL_FLAGS_ALIGN_LINE   (1 << 1)
+
+/**
+ * @brief Pool of equally sized objects.
+ *
+ * The objects follow the header in a single block. Free objects are linked
+ * through their first word, so allocating and freeing just pops and pushes
+ * that list: no search and no per-object header.
+ */
+typedef struct pool_s
+{
+    void* free_list;          // First free object, or NULL if the pool is exhausted.
+    uint32_t obj_size;        // Distance between objects in bytes.
+    uint32_t count;           // Number of objects.
+    uint32_t free_count;      // Number of objects in #free_list.
+    uint32_t flags;           // Pool flags (POOL_FLAGS_*).
+    uint8_t* objects;         // The first object.
+} pool_t;
+
+/**
+ * @brief Create a pool on the kernel heap.
+ *
+ * @param[in]  obj_size Size of an object in bytes, rounded up to a multiple of 4 (or 16 with #POOL_FLAGS_ALIGN_LINE).
+ * @param[in]  count    Number of objects.
+ * @param[in]  flags    Pool flags (POOL_FLAGS_*).
+ * @return              The pool, or NULL if it doesn't fit into the heap.
+ */
+pool_t* pool_create(uint32_t obj_size, uint32_t count, uint32_t flags);
+
+/**
+ * @brief Create a pool in the user segment, so that userspace can allocate from it without syscalls.
+ *
+ * The user segment is mapped cached, so #POOL_FLAGS_UNCACHED is not supported.
+ * User pools can't be destroyed.
+ *
+ * @param[in]  obj_size Size of an object in bytes.
+ * @param[in]  count    Number of objects.
+ * @param[in]  flags    Pool flags (POOL_FLAGS_*).
+ * @return              The pool at its user segment address, or NULL if it doesn't fit.
+ */
+pool_t* pool_create_useg(uint32_t obj_size, uint32_t count, uint32_t flags);
+
+/**
+ * @brief Give a pool created by #pool_create back to the heap. Its objects become invalid.
+ *
+ * @param[in]  pool     The pool to destroy, or NULL.
+ */
+void pool_destroy(pool_t* pool);
+
+/**
+ * @brief Allocate an object from a pool.
+ *
+ * Inline so that userspace can use its pools directly.
+ *
+ * @param[in]  pool     The pool to allocate from.
+ * @return              The object, or NULL if all objects are in use. Its contents are undefined.
+ */
+static inline void* pool_alloc(pool_t* pool)
+{
+    void** obj = pool->free_list;
+    if (obj != NULL)
+    {
+        pool->free_list = *obj;
+        pool->free_count--;
+    }
+
+    return obj;
+}
+
+/**
+ * @brief Return an object to its pool.
+ *
+ * @param[in]  pool     The pool the object was allocated from.
+ * @param[in]  obj      The object, or NULL.
+ */
+static inline void pool_free(pool_t* pool, void* obj)
+{
+    if (obj == NULL)
+    {
+        return;
+    }
+
+    *(void**) obj = pool->free_list;
+    pool->free_list = obj;
+    pool->free_count++;
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef KIVOS64_PRIMITIVES_H
+#define KIVOS64_PRIMITIVES_H
+
+#include "intdef.h"
+#include "graphics.h"
+
+/**
+ * @brief Draw a line while performing clipping. Both end points are included.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x0       The x coordinate of the start point.
+ * @param[in]  y0       The y coordinate of the start point.
+ * @param[in]  x1       The x coordinate of the end point.
+ * @param[in]  y1       The y coordinate of the end point.
+ * @param[in]  color    The 32-bit RGBA color to draw.
+ */
+void graphics_draw_line(surface_t* dst, int x0, int y0, int x1, int y1, uint32_t color);
+
+/**
+ * @brief Draw an alpha-blended line while performing clipping. Every pixel is blended exactly once.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x0       The x coordinate of the start point.
+ * @param[in]  y0       The y coordinate of the start point.
+ * @param[in]  x1       The x coordinate of the end point.
+ * @param[in]  y1       The y coordinate of the end point.
+ * @param[in]  color    The 32-bit RGBA color to blend.
+ */
+void graphics_draw_line_alpha(surface_t* dst, int x0, int y0, int x1, int y1, uint32_t color);
+
+/**
+ * @brief Draw the outline of a rectangle while performing clipping.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x        The x coordinate of the top left corner.
+ * @param[in]  y        The y coordinate of the top left corner.
+ * @param[in]  width    Width of the rectangle.
+ * @param[in]  height   Height of the rectangle.
+ * @param[in]  color    The 32-bit RGBA color to draw.
+ */
+void graphics_draw_rect(surface_t* dst, int x, int y, int width, int height, uint32_t color);
+
+/**
+ * @brief Draw the alpha-blended outline of a rectangle while performing clipping.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x        The x coordinate of the top left corner.
+ * @param[in]  y        The y coordinate of the top left corner.
+ * @param[in]  width    Width of the rectangle.
+ * @param[in]  height   Height of the rectangle.
+ * @param[in]  color    The 32-bit RGBA color to blend.
+ */
+void graphics_draw_rect_alpha(surface_t* dst, int x, int y, int width, int height, uint32_t color);
+
+/**
+ * @brief Fill an alpha-blended rectangle while performing clipping.
+ *
+ * The opaque variant is #graphics_fill_rect.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x        The x coordinate of the top left corner.
+ * @param[in]  y        The y coordinate of the top left corner.
+ * @param[in]  width    Width of the rectangle.
+ * @param[in]  height   Height of the rectangle.
+ * @param[in]  color    The 32-bit RGBA color to blend.
+ */
+void graphics_fill_rect_alpha(surface_t* dst, int x, int y, int width, int height, uint32_t color);
+
+/**
+ * @brief Draw the outline of a circle while performing clipping.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  cx       The x coordinate of the center.
+ * @param[in]  cy       The y coordinate of the center.
+ * @param[in]  radius   Radius in pixels.
+ * @param[in]  color    The 32-bit RGBA color to draw.
+ */
+void graphics_draw_circle(surface_t* dst, int cx, int cy, int radius, uint32_t color);
+
+/**
+ * @brief Draw the alpha-blended outline of a circle while performing clipping.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  cx       The x coordinate of the center.
+ * @param[in]  cy       The y coordinate of the center.
+ * @param[in]  radius   Radius in pixels.
+ * @param[in]  color    The 32-bit RGBA color to blend.
+ */
+void graphics_draw_circle_alpha(surface_t* dst, int cx, int cy, int radius, uint32_t color);
+
+/**
+ * @brief Fill a circle while performing clipping.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  cx       The x coordinate of the center.
+ * @param[in]  cy       The y coordinate of the center.
+ * @param[in]  radius   Radius in pixels.
+ * @param[in]  color    The 32-bit RGBA color to draw.
+ */
+void graphics_fill_circle(surface_t* dst, int cx, int cy, int radius, uint32_t color);
+
+/**
+ * @brief Fill an alpha-blended circle while performing clipping.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  cx       The x coordinate of the center.
+ * @param[in]  cy       The y coordinate of the center.
+ * @param[in]  radius   Radius in pixels.
+ * @param[in]  color    The 32-bit RGBA color to blend.
+ */
+void graphics_fill_circle_alpha(surface_t* dst, int cx, int cy, int radius, uint32_t color);
+
+#endif
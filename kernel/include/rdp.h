@@ -0,0 +1,103 @@
+#ifndef KIVOS64_RDP_H
+#define KIVOS64_RDP_H
+
+#include "intdef.h"
+#include "graphics.h"
+
+/**
+ * @brief Check whether the RDP is able to draw into a given surface.
+ *
+ * The RDP requires the framebuffer to be 8-byte aligned and less than 1024 pixels wide and high.
+ *
+ * @param[in]  surface  The surface to draw to.
+ * @return              True if the RDP can render into the surface.
+ */
+bool rdp_can_target(surface_t* surface);
+
+/**
+ * @brief Check whether the RDP is able to use a given surface as a texture.
+ *
+ * The RDP requires the texture to be 8-byte aligned and less than 1024 pixels wide and high.
+ *
+ * @param[in]  surface  The surface to read from.
+ * @return              True if the RDP can load the surface into TMEM.
+ */
+bool rdp_can_texture(surface_t* surface);
+
+/**
+ * @brief Queue a solid color rectangle fill.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x0       Left edge (inclusive).
+ * @param[in]  y0       Top edge (inclusive).
+ * @param[in]  x1       Right edge (exclusive).
+ * @param[in]  y1       Bottom edge (exclusive).
+ * @param[in]  color    The 32-bit RGBA color to fill with.
+ */
+void rdp_fill_rectangle(surface_t* dst, int x0, int y0, int x1, int y1, uint32_t color);
+
+/**
+ * @brief Queue an alpha-blended blit of a region of the source surface.
+ *
+ * The region is expected to be already clipped against the destination surface.
+ * The region's top left corner is drawn at (x + src_x0, y + src_y0).
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  x        The x coordinate of the source surface origin.
+ * @param[in]  y        The y coordinate of the source surface origin.
+ * @param[in]  src      The surface to draw from.
+ * @param[in]  src_x0   Left edge of the region in the source surface (inclusive).
+ * @param[in]  src_y0   Top edge of the region in the source surface (inclusive).
+ * @param[in]  src_x1   Right edge of the region in the source surface (exclusive).
+ * @param[in]  src_y1   Bottom edge of the region in the source surface (exclusive).
+ */
+void rdp_draw_surface_alpha(surface_t* dst, int x, int y, surface_t* src, int src_x0, int src_y0, int src_x1, int src_y1);
+
+/**
+ * @brief Send all queued commands to the RDP. Does not wait for them to finish.
+ */
+void rdp_flush(void);
+
+/**
+ * @brief Send all queued commands to the RDP and wait until the RDP finishes drawing.
+ *
+ * This must be called before the CPU touches any surface the RDP might be drawing to,
+ * unless it's known which one, see #rdp_wait_surface.
+ */
+void rdp_wait(void);
+
+/**
+ * @brief Send all queued commands to the RDP and get a fence for them. Does not wait.
+ *
+ * @return              Fence that is done once the RDP has finished all commands queued so far.
+ */
+uint32_t rdp_fence(void);
+
+/**
+ * @brief Check whether the RDP has finished the commands of a fence.
+ *
+ * Safe to call from interrupt handlers.
+ *
+ * @param[in]  fence    Fence returned by #rdp_fence.
+ * @return              True if all commands of the fence have been drawn.
+ */
+bool rdp_fence_done(uint32_t fence);
+
+/**
+ * @brief Wait until the RDP has finished the commands of a fence.
+ *
+ * @param[in]  fence    Fence returned by #rdp_fence.
+ */
+void rdp_wait_fence(uint32_t fence);
+
+/**
+ * @brief Wait until the RDP has finished drawing into a surface and texturing from it.
+ *
+ * Unlike #rdp_wait, this doesn't wait for work on other surfaces, so the CPU can
+ * draw the next frame while the RDP is still busy with the previous one.
+ *
+ * @param[in]  surface  The surface the CPU is about to touch or free.
+ */
+void rdp_wait_surface(surface_t* surface);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef KIVOS64_RSP_H
+#define KIVOS64_RSP_H
+
+#include "intdef.h"
+
+/**
+ * @brief Description of a job for the RSP.
+ *
+ * The microcode is loaded at the start of IMEM and the input data at the start
+ * of DMEM. The microcode must finish with a break instruction. Once it does,
+ * the output region of DMEM is copied back to RDRAM and the task is marked done.
+ *
+ * All RDRAM buffers must be 8-byte aligned and their sizes multiples of 8.
+ * The output buffer should also be 16-byte aligned and padded so that invalidating
+ * it doesn't throw away unrelated data sharing its cache lines.
+ */
+typedef struct rsp_task_s
+{
+    /** @brief Microcode to run. At most 4 KiB. */
+    const void* ucode;
+    /** @brief Size of microcode in bytes. */
+    uint32_t ucode_size;
+    /** @brief Input data copied to DMEM offset 0 before the task starts. May be NULL. */
+    const void* data;
+    /** @brief Size of input data in bytes. */
+    uint32_t data_size;
+    /** @brief Buffer that receives DMEM contents after the task finishes. May be NULL. */
+    void* output;
+    /** @brief Size of output data in bytes. */
+    uint32_t output_size;
+    /** @brief DMEM offset of output data. */
+    uint32_t output_offset;
+    /** @brief Set once the task has finished and its output has been written back. */
+    volatile bool done;
+} rsp_task_t;
+
+/**
+ * @brief Copy a block of memory from RDRAM into IMEM. The RSP must be halted.
+ *
+ * @param[in]  code     8-byte aligned pointer to microcode.
+ * @param[in]  size     Size in bytes, multiple of 8.
+ */
+void rsp_load_code(const void* code, uint32_t size);
+
+/**
+ * @brief Copy a block of memory from RDRAM into DMEM. The RSP must be halted.
+ *
+ * @param[in]  data     8-byte aligned pointer to data.
+ * @param[in]  size     Size in bytes, multiple of 8.
+ * @param[in]  offset   8-byte aligned offset in DMEM.
+ */
+void rsp_load_data(const void* data, uint32_t size, uint32_t offset);
+
+/**
+ * @brief Copy a block of memory from DMEM into RDRAM. The RSP must be halted.
+ *
+ * @param[out] data     8-byte aligned pointer to receive data.
+ * @param[in]  size     Size in bytes, multiple of 8.
+ * @param[in]  offset   8-byte aligned offset in DMEM.
+ */
+void rsp_read_data(void* data, uint32_t size, uint32_t offset);
+
+/**
+ * @brief Queue a task for the RSP. Starts it immediately if the RSP is idle.
+ *
+ * @param[in]  task     The task to run. Must stay valid until it's done.
+ */
+void rsp_task_submit(rsp_task_t* task);
+
+/**
+ * @brief Wait until a submitted task has finished.
+ *
+ * @param[in]  task     The task to wait for.
+ */
+void rsp_task_wait(rsp_task_t* task);
+
+/**
+ * @brief Check whether the RSP is running a task.
+ */
+bool rsp_busy(void);
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file sp.h
+ * @brief The Signal Processor interface (or SP) is one of multiple I/O interfaces in the RCP. It controls the RSP and the DMA engine moving data between RDRAM and the RSP's IMEM/DMEM.
+ */
+
+#ifndef KIVOS64_SP_H
+#define KIVOS64_SP_H
+
+#include "intdef.h"
+
+#define SP_REG_BASE                 (0xA4040000)
+#define SP_PC_ADDR                  ((volatile uint32_t*) 0xA4080000)
+
+// Base address of RSP data memory (4 KiB).
+#define SP_DMEM_BASE                (0xA4000000)
+// Base address of RSP instruction memory (4 KiB).
+#define SP_IMEM_BASE                (0xA4001000)
+// Size of each of the RSP memories.
+#define SP_MEM_SIZE                 (0x1000)
+// SP_MEM_ADDR: Select IMEM instead of DMEM.
+#define SP_MEM_ADDR_IMEM            (1 << 12)
+
+// Read bits.
+#define SP_STATUS_HALTED            (1 << 0)      // RSP is halted.
+#define SP_STATUS_BROKE             (1 << 1)      // RSP executed a break instruction.
+#define SP_STATUS_DMA_BUSY          (1 << 2)      // DMA transfer in progress.
+#define SP_STATUS_DMA_FULL          (1 << 3)      // DMA transfer pending.
+#define SP_STATUS_IO_FULL           (1 << 4)      // IO is busy.
+#define SP_STATUS_SSTEP             (1 << 5)      // Single step mode.
+#define SP_STATUS_INTR_BREAK        (1 << 6)      // Raise interrupt when RSP executes break.
+#define SP_STATUS_SIG(n)            (1 << (7 + (n)))  // Signal n is set.
+// Write bits.
+#define SP_STATUS_CLR_HALT          (1 << 0)      // Start running RSP code.
+#define SP_STATUS_SET_HALT          (1 << 1)      // Stop running RSP code.
+#define SP_STATUS_CLR_BROKE         (1 << 2)      // Clear broke flag.
+#define SP_STATUS_CLR_INTR          (1 << 3)      // Acknowledge SP interrupt.
+#define SP_STATUS_SET_INTR          (1 << 4)      // Raise SP interrupt.
+#define SP_STATUS_CLR_SSTEP         (1 << 5)      // Disable single step mode.
+#define SP_STATUS_SET_SSTEP         (1 << 6)      // Enable single step mode.
+#define SP_STATUS_CLR_INTR_BREAK    (1 << 7)      // Don't raise interrupt on break.
+#define SP_STATUS_SET_INTR_BREAK    (1 << 8)      // Raise interrupt on break.
+#define SP_STATUS_CLR_SIG(n)        (1 << (9 + 2 * (n)))    // Clear signal n.
+#define SP_STATUS_SET_SIG(n)        (1 << (10 + 2 * (n)))   // Set signal n.
+
+typedef struct SP_registers_s
+{
+    /** @brief Address in IMEM/DMEM, must be 8 byte aligned. */
+    uint32_t mem_address;
+    /** @brief Address in RDRAM, must be 8 byte aligned. */
+    uint32_t ram_address;
+    /** @brief
+     * Length of data to transfer from RDRAM into IMEM/DMEM, minus one.
+     * Writing to this register will start DMA transfer.
+     */
+    uint32_t read_length;
+    /** @brief
+     * Length of data to transfer from IMEM/DMEM into RDRAM, minus one.
+     * Writing to this register will start DMA transfer.
+     */
+    uint32_t write_length;
+    /** @brief Status of the RSP. Writing to this register changes its mode. */
+    uint32_t status;
+    /** @brief Mirror of the DMA full bit of the status register. */
+    uint32_t dma_full;
+    /** @brief Mirror of the DMA busy bit of the status register. */
+    uint32_t dma_busy;
+    /** @brief Hardware semaphore. Reading sets it, writing clears it. */
+    uint32_t semaphore;
+} SP_registers_t;
+
+extern volatile SP_registers_t* const SP_regs;
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef KIVOS64_SPRITE_H
+#define KIVOS64_SPRITE_H
+
+#include "intdef.h"
+#include "graphics.h"
+
+/** @brief Maximum number of draws #sprite_batch_draw accepts in one call. */
+#define SPRITE_BATCH_MAX        (256)
+
+/**
+ * @brief Position of a single frame within a sprite atlas.
+ */
+typedef struct sprite_frame_s
+{
+    uint16_t x;               // X coordinate in the atlas texture.
+    uint16_t y;               // Y coordinate in the atlas texture.
+    uint16_t width;           // Width in pixels.
+    uint16_t height;          // Height in pixels.
+} sprite_frame_t;
+
+/**
+ * @brief Many sprite frames packed into one texture, as produced by tools/spriteconv (--grid).
+ */
+typedef struct sprite_atlas_s
+{
+    surface_t* texture;             // Texture holding all frames.
+    const sprite_frame_t* frames;   // Frame descriptors.
+    uint32_t frame_count;           // Number of frames.
+} sprite_atlas_t;
+
+/**
+ * @brief A request to draw one frame of an atlas.
+ */
+typedef struct sprite_draw_s
+{
+    const sprite_atlas_t* atlas;    // The atlas to draw from.
+    uint16_t frame;                 // Index of the frame in the atlas.
+    int16_t x;                      // The x coordinate of the sprite.
+    int16_t y;                      // The y coordinate of the sprite.
+    uint16_t padding;
+} sprite_draw_t;
+
+/**
+ * @brief Draw a batch of sprites while performing clipping and alphablending.
+ *
+ * Draws are sorted by atlas and then by y before drawing, so sprites sharing a
+ * texture are drawn together and sprites lower on screen end up on top. Reading
+ * one atlas at a time keeps more of it in the data cache.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  draws    The sprites to draw.
+ * @param[in]  count    Number of sprites, at most #SPRITE_BATCH_MAX.
+ */
+void sprite_batch_draw(surface_t* dst, const sprite_draw_t* draws, int count);
+
+#endif
@@ -29,6 +29,9 @@ extern int __boot_resettype;
 #define ADDR_TO_PHYS(addr)  ((addr) & 0x1FFFFFFF)
 #define ADDR_TO_KSEG0(addr) ((addr) | MEM_KSEG0_BASE)
 #define ADDR_TO_KSEG1(addr) ((addr) | MEM_KSEG1_BASE)
+// Turn a userspace address into one the kernel can access. Kernel segment addresses
+// stay as they are, so uncached buffers are never read through the cache.
+#define ADDR_USER_TO_KERNEL(addr) (((addr) & MEM_KSEG0_BASE) ? (addr) : ADDR_TO_KSEG0(addr))
 
 void data_cache_index_writeback_invalidate(volatile void* addr, unsigned long length);
 
@@ -38,6 +41,24 @@ void data_cache_hit_writeback_invalidate(volatile void* addr, unsigned long leng
 
 void data_cache_hit_writeback(volatile void* addr, unsigned long length);
 
+/** @brief Write back and invalidate the whole data cache. */
+void data_cache_writeback_invalidate_all(void);
+
+/** @brief Write back a range, switching to a whole-cache flush for ranges larger than the cache. */
+void data_cache_range_writeback(volatile void* addr, unsigned long length);
+
+/** @brief Write back and invalidate a range, switching to a whole-cache flush for ranges larger than the cache. */
+void data_cache_range_writeback_invalidate(volatile void* addr, unsigned long length);
+
+/**
+ * @brief Check whether any line of a range is in the data cache, for debug checks of uncached memory.
+ *
+ * @param[in]  addr     Start of the range, in any segment.
+ * @param[in]  length   Length in bytes.
+ * @return              True if some line of the range is valid in the data cache.
+ */
+bool data_cache_range_resident(volatile void* addr, unsigned long length);
+
 void inst_cache_index_invalidate(volatile void* addr, unsigned long length);
 
 void inst_cache_hit_invalidate(volatile void* addr, unsigned long length);
@@ -0,0 +1,44 @@
+#ifndef KIVOS64_TILEMAP_H
+#define KIVOS64_TILEMAP_H
+
+#include "intdef.h"
+#include "graphics.h"
+
+/** @brief Tile index that leaves the destination untouched. */
+#define TILEMAP_EMPTY       (0xFFFF)
+
+/**
+ * @brief A background layer made of equally sized tiles.
+ *
+ * Tiles are taken from a tileset atlas, numbered left to right and top to bottom.
+ * Indices past the last whole tile of the atlas are left empty.
+ * The map wraps around in both directions, so scrolling past its edge shows
+ * its opposite side.
+ */
+typedef struct tilemap_s
+{
+    surface_t* tileset;       // Atlas holding all tiles.
+    const uint16_t* tiles;    // Tile indices, #width * #height of them in row-major order.
+    uint16_t tile_width;      // Width of a tile in pixels.
+    uint16_t tile_height;     // Height of a tile in pixels.
+    uint16_t width;           // Width of the map in tiles.
+    uint16_t height;          // Height of the map in tiles.
+    int32_t scroll_x;         // Map pixel shown at the left edge of the viewport.
+    int32_t scroll_y;         // Map pixel shown at the top edge of the viewport.
+    int16_t x;                // X coordinate of the viewport on the destination surface.
+    int16_t y;                // Y coordinate of the viewport on the destination surface.
+    uint16_t view_width;      // Width of the viewport in pixels.
+    uint16_t view_height;     // Height of the viewport in pixels.
+} tilemap_t;
+
+/**
+ * @brief Draw a tilemap layer into its viewport while performing clipping.
+ *
+ * Tiles are drawn opaque. Every tile row is a single block copy from the tileset.
+ *
+ * @param[in]  dst      The surface to draw to.
+ * @param[in]  map      The tilemap to draw.
+ */
+void tilemap_draw(surface_t* dst, const tilemap_t* map);
+
+#endif
@@ -5,6 +5,10 @@
 #include "audio.h"
 #include "controller.h"
 #include "graphics.h"
+#include "tilemap.h"
+#include "sprite.h"
+#include "pool.h"
+#include "arena.h"
 #include "system.h"
 
 // So apparently having this specific function optimized under -Os
@@ -59,15 +63,296 @@ void graphics_draw_surface_alpha_user(surface_t* dst, int x, int y, surface_t* s
     asm volatile("syscall");
 }
 
-void display_init_user(int width, int height, filter_t filter)
+void graphics_draw_sprite_rle_user(surface_t* dst, int x, int y, const sprite_rle_t* sprite)
 {
+    uint32_t dst_addr = ADDR_TO_KSEG0((uint32_t) dst);
+    // Convert sprite (user data) to kernel segment.
+    uint32_t sprite_addr = ADDR_TO_KSEG0((uint32_t) sprite);
+    asm volatile("move $t4, %0" : : "r" (dst_addr));
+    asm volatile("move $t5, %0" : : "r" (x));
+    asm volatile("move $t6, %0" : : "r" (y));
+    asm volatile("move $t7, %0" : : "r" (sprite_addr));
+    asm volatile("li $v0, 8");
+    asm volatile("syscall");
+}
+
+void graphics_restore_background_user(surface_t* surface, uint32_t color)
+{
+    asm volatile("move $t4, %0" : : "r" ((uint32_t) surface));
+    asm volatile("move $t5, %0" : : "r" (color));
+    asm volatile("li $v0, 9");
+    asm volatile("syscall");
+}
+
+/** @brief Number of commands buffered before #graphics_submit_user is called automatically. */
+#define GRAPHICS_USER_BATCH_SIZE    (64)
+
+/** @brief Drawing commands waiting to be submitted to the kernel. */
+static graphics_cmd_t __graphics_batch[GRAPHICS_USER_BATCH_SIZE];
+/** @brief Number of commands in #__graphics_batch. */
+static int __graphics_batch_count = 0;
+
+/**
+ * @brief Execute all buffered drawing commands with a single syscall.
+ *
+ * Must be called before the display is handed over to #display_show_user.
+ */
+void graphics_submit_user(void)
+{
+    if (__graphics_batch_count == 0)
+    {
+        return;
+    }
+
+    // Convert the batch (user data) to kernel segment.
+    uint32_t cmds_addr = ADDR_TO_KSEG0((uint32_t) __graphics_batch);
+    asm volatile("move $t4, %0" : : "r" (cmds_addr));
+    asm volatile("move $t5, %0" : : "r" (__graphics_batch_count));
+    asm volatile("li $v0, 10");
+    asm volatile("syscall");
+
+    __graphics_batch_count = 0;
+}
+
+/** @brief Get the next free command in the batch, submitting the batch if it's full. */
+static graphics_cmd_t* graphics_batch_push_user(graphics_cmd_type_t type, surface_t* dst)
+{
+    if (__graphics_batch_count == GRAPHICS_USER_BATCH_SIZE)
+    {
+        graphics_submit_user();
+    }
+
+    graphics_cmd_t* cmd = &__graphics_batch[__graphics_batch_count++];
+    cmd->type = type;
+    cmd->flags = 0;
+    cmd->dst = (surface_t*) ADDR_TO_KSEG0((uint32_t) dst);
+    return cmd;
+}
+
+void graphics_batch_fill_user(surface_t* surface, uint32_t color)
+{
+    graphics_cmd_t* cmd = graphics_batch_push_user(GRAPHICS_CMD_FILL, surface);
+    cmd->color = color;
+}
+
+void graphics_batch_restore_background_user(surface_t* surface, uint32_t color)
+{
+    graphics_cmd_t* cmd = graphics_batch_push_user(GRAPHICS_CMD_RESTORE_BACKGROUND, surface);
+    cmd->color = color;
+}
+
+void graphics_batch_fill_rect_user(surface_t* surface, int x, int y, int width, int height, uint32_t color)
+{
+    graphics_cmd_t* cmd = graphics_batch_push_user(GRAPHICS_CMD_FILL_RECT, surface);
+    cmd->x = x;
+    cmd->y = y;
+    cmd->width = width;
+    cmd->height = height;
+    cmd->color = color;
+}
+
+void graphics_batch_fill_rect_alpha_user(surface_t* surface, int x, int y, int width, int height, uint32_t color)
+{
+    graphics_cmd_t* cmd = graphics_batch_push_user(GRAPHICS_CMD_FILL_RECT, surface);
+    cmd->x = x;
+    cmd->y = y;
+    cmd->width = width;
+    cmd->height = height;
+    cmd->color = color;
+    cmd->flags |= GRAPHICS_CMD_FLAGS_ALPHA;
+}
+
+void graphics_batch_draw_line_user(surface_t* surface, int x0, int y0, int x1, int y1, uint32_t color, uint16_t flags)
+{
+    graphics_cmd_t* cmd = graphics_batch_push_user(GRAPHICS_CMD_DRAW_LINE, surface);
+    cmd->x = x0;
+    cmd->y = y0;
+    cmd->x1 = x1;
+    cmd->y1 = y1;
+    cmd->color = color;
+    cmd->flags = flags;
+}
+
+void graphics_batch_draw_rect_user(surface_t* surface, int x, int y, int width, int height, uint32_t color, uint16_t flags)
+{
+    graphics_cmd_t* cmd = graphics_batch_push_user(GRAPHICS_CMD_DRAW_RECT, surface);
+    cmd->x = x;
+    cmd->y = y;
+    cmd->width = width;
+    cmd->height = height;
+    cmd->color = color;
+    cmd->flags = flags;
+}
+
+void graphics_batch_draw_circle_user(surface_t* surface, int cx, int cy, int radius, bool filled, uint32_t color, uint16_t flags)
+{
+    graphics_cmd_t* cmd = graphics_batch_push_user(filled ? GRAPHICS_CMD_FILL_CIRCLE : GRAPHICS_CMD_DRAW_CIRCLE, surface);
+    cmd->x = cx;
+    cmd->y = cy;
+    cmd->radius = radius;
+    cmd->color = color;
+    cmd->flags = flags;
+}
+
+void graphics_batch_draw_surface_user(surface_t* dst, int x, int y, surface_t* src)
+{
+    graphics_cmd_t* cmd = graphics_batch_push_user(GRAPHICS_CMD_DRAW_SURFACE, dst);
+    cmd->x = x;
+    cmd->y = y;
+    cmd->src = (surface_t*) ADDR_TO_KSEG0((uint32_t) src);
+}
+
+void graphics_batch_draw_surface_alpha_user(surface_t* dst, int x, int y, surface_t* src)
+{
+    graphics_cmd_t* cmd = graphics_batch_push_user(GRAPHICS_CMD_DRAW_SURFACE_ALPHA, dst);
+    cmd->x = x;
+    cmd->y = y;
+    cmd->src = (surface_t*) ADDR_TO_KSEG0((uint32_t) src);
+}
+
+void graphics_batch_draw_sprite_rle_user(surface_t* dst, int x, int y, const sprite_rle_t* sprite)
+{
+    graphics_cmd_t* cmd = graphics_batch_push_user(GRAPHICS_CMD_DRAW_SPRITE_RLE, dst);
+    cmd->x = x;
+    cmd->y = y;
+    cmd->sprite = (const sprite_rle_t*) ADDR_TO_KSEG0((uint32_t) sprite);
+}
+
+void tilemap_draw_user(surface_t* dst, const tilemap_t* map)
+{
+    uint32_t dst_addr = ADDR_TO_KSEG0((uint32_t) dst);
+    // Convert map (user data) to kernel segment.
+    uint32_t map_addr = ADDR_TO_KSEG0((uint32_t) map);
+    asm volatile("move $t4, %0" : : "r" (dst_addr));
+    asm volatile("move $t5, %0" : : "r" (map_addr));
+    asm volatile("li $v0, 13");
+    asm volatile("syscall");
+}
+
+void sprite_batch_draw_user(surface_t* dst, const sprite_draw_t* draws, int count)
+{
+    uint32_t dst_addr = ADDR_TO_KSEG0((uint32_t) dst);
+    // Convert draws (user data) to kernel segment.
+    uint32_t draws_addr = ADDR_TO_KSEG0((uint32_t) draws);
+    asm volatile("move $t4, %0" : : "r" (dst_addr));
+    asm volatile("move $t5, %0" : : "r" (draws_addr));
+    asm volatile("move $t6, %0" : : "r" (count));
+    asm volatile("li $v0, 14");
+    asm volatile("syscall");
+}
+
+void graphics_draw_line_user(surface_t* dst, int x0, int y0, int x1, int y1, uint32_t color)
+{
+    uint32_t dst_addr = ADDR_TO_KSEG0((uint32_t) dst);
+    uint32_t arg2 = GRAPHICS_PACK_XY(x0, y0);
+    uint32_t arg3 = GRAPHICS_PACK_XY(x1, y1);
+    asm volatile("move $t4, %0" : : "r" (dst_addr));
+    asm volatile("move $t5, %0" : : "r" (arg2));
+    asm volatile("move $t6, %0" : : "r" (arg3));
+    asm volatile("move $t7, %0" : : "r" (color));
+    asm volatile("li $v0, 15");
+    asm volatile("syscall");
+}
+
+void graphics_draw_rect_user(surface_t* dst, int x, int y, int width, int height, uint32_t color)
+{
+    uint32_t dst_addr = ADDR_TO_KSEG0((uint32_t) dst);
+    uint32_t arg2 = GRAPHICS_PACK_XY(x, y);
+    uint32_t arg3 = GRAPHICS_PACK_XY(width, height);
+    asm volatile("move $t4, %0" : : "r" (dst_addr));
+    asm volatile("move $t5, %0" : : "r" (arg2));
+    asm volatile("move $t6, %0" : : "r" (arg3));
+    asm volatile("move $t7, %0" : : "r" (color));
+    asm volatile("li $v0, 16");
+    asm volatile("syscall");
+}
+
+void graphics_fill_rect_user(surface_t* dst, int x, int y, int width, int height, uint32_t color)
+{
+    uint32_t dst_addr = ADDR_TO_KSEG0((uint32_t) dst);
+    uint32_t arg2 = GRAPHICS_PACK_XY(x, y);
+    uint32_t arg3 = GRAPHICS_PACK_XY(width, height);
+    asm volatile("move $t4, %0" : : "r" (dst_addr));
+    asm volatile("move $t5, %0" : : "r" (arg2));
+    asm volatile("move $t6, %0" : : "r" (arg3));
+    asm volatile("move $t7, %0" : : "r" (color));
+    asm volatile("li $v0, 17");
+    asm volatile("syscall");
+}
+
+void graphics_draw_circle_user(surface_t* dst, int cx, int cy, int radius, uint32_t color)
+{
+    uint32_t dst_addr = ADDR_TO_KSEG0((uint32_t) dst);
+    uint32_t arg2 = GRAPHICS_PACK_XY(cx, cy);
+    uint32_t arg3 = radius;
+    asm volatile("move $t4, %0" : : "r" (dst_addr));
+    asm volatile("move $t5, %0" : : "r" (arg2));
+    asm volatile("move $t6, %0" : : "r" (arg3));
+    asm volatile("move $t7, %0" : : "r" (color));
+    asm volatile("li $v0, 18");
+    asm volatile("syscall");
+}
+
+void graphics_fill_circle_user(surface_t* dst, int cx, int cy, int radius, uint32_t color)
+{
+    uint32_t dst_addr = ADDR_TO_KSEG0((uint32_t) dst);
+    uint32_t arg2 = GRAPHICS_PACK_XY(cx, cy);
+    uint32_t arg3 = radius;
+    asm volatile("move $t4, %0" : : "r" (dst_addr));
+    asm volatile("move $t5, %0" : : "r" (arg2));
+    asm volatile("move $t6, %0" : : "r" (arg3));
+    asm volatile("move $t7, %0" : : "r" (color));
+    asm volatile("li $v0, 19");
+    asm volatile("syscall");
+}
+
+void graphics_draw_surface_transformed_user(surface_t* dst, int x, int y, surface_t* src, const blit_params_t* params)
+{
+    uint32_t dst_addr = ADDR_TO_KSEG0((uint32_t) dst);
+    uint32_t arg2 = GRAPHICS_PACK_XY(x, y);
+    uint32_t src_addr = ADDR_TO_KSEG0((uint32_t) src);
+    uint32_t params_addr = ADDR_TO_KSEG0((uint32_t) params);
+    asm volatile("move $t4, %0" : : "r" (dst_addr));
+    asm volatile("move $t5, %0" : : "r" (arg2));
+    asm volatile("move $t6, %0" : : "r" (src_addr));
+    asm volatile("move $t7, %0" : : "r" (params_addr));
+    asm volatile("li $v0, 20");
+    asm volatile("syscall");
+}
+
+void graphics_draw_text_user(surface_t* dst, int x, int y, const char* text, uint32_t color)
+{
+    uint32_t dst_addr = ADDR_TO_KSEG0((uint32_t) dst);
+    uint32_t arg2 = GRAPHICS_PACK_XY(x, y);
+    uint32_t text_addr = ADDR_TO_KSEG0((uint32_t) text);
+    asm volatile("move $t4, %0" : : "r" (dst_addr));
+    asm volatile("move $t5, %0" : : "r" (arg2));
+    asm volatile("move $t6, %0" : : "r" (text_addr));
+    asm volatile("move $t7, %0" : : "r" (color));
+    asm volatile("li $v0, 21");
+    asm volatile("syscall");
+}
+
+void display_init_user(int width, int height, surface_format_t format, int num_buffers, present_mode_t present_mode, filter_t filter)
+{
+    // Only four argument registers, so pack the small ones together.
+    uint32_t config = (format & 0xFF) | ((num_buffers & 0xFF) << 8) | ((present_mode & 0xFF) << 16);
+
     asm volatile("move $t4, %0" : : "r" (width));
     asm volatile("move $t5, %0" : : "r" (height));
-    asm volatile("move $t6, %0" : : "r" (filter));
+    asm volatile("move $t6, %0" : : "r" (config));
+    asm volatile("move $t7, %0" : : "r" (filter));
     asm volatile("li $v0, 5");
     asm volatile("syscall");
 }
 
+void display_set_cached_user(bool cached)
+{
+    asm volatile("move $t4, %0" : : "r" ((uint32_t) cached));
+    asm volatile("li $v0, 11");
+    asm volatile("syscall");
+}
+
 surface_t* display_get_user(void)
 {
     uint32_t retval;
@@ -80,6 +365,18 @@ surface_t* display_get_user(void)
     return (surface_t*) retval;
 }
 
+surface_t* display_try_get_user(void)
+{
+    uint32_t retval;
+
+    asm volatile("li $v0, 12");
+    asm volatile("syscall");
+
+    asm volatile("move %0, $t8" : "=r" (retval));
+    
+    return (surface_t*) retval;
+}
+
 void display_show_user(surface_t* surface)
 {
     asm volatile("move $t4, %0" : : "r" ((uint32_t) surface));
@@ -87,4 +384,54 @@ void display_show_user(surface_t* surface)
     asm volatile("syscall");
 }
 
+void display_get_stats_user(display_stats_t* stats)
+{
+    uint32_t stats_addr = ADDR_TO_KSEG0((uint32_t) stats);
+    asm volatile("move $t4, %0" : : "r" (stats_addr));
+    asm volatile("li $v0, 22");
+    asm volatile("syscall");
+}
+
+void display_set_stats_dump_user(int interval)
+{
+    asm volatile("move $t4, %0" : : "r" ((uint32_t) interval));
+    asm volatile("li $v0, 23");
+    asm volatile("syscall");
+}
+
+/**
+ * @brief Create a pool in the user segment. Objects are then allocated and freed with
+ * #pool_alloc and #pool_free directly, without syscalls.
+ */
+pool_t* pool_create_user(uint32_t obj_size, uint32_t count, uint32_t flags)
+{
+    uint32_t retval;
+
+    asm volatile("move $t4, %0" : : "r" (obj_size));
+    asm volatile("move $t5, %0" : : "r" (count));
+    asm volatile("move $t6, %0" : : "r" (flags));
+    asm volatile("li $v0, 24");
+    asm volatile("syscall");
+
+    asm volatile("move %0, $t8" : "=r" (retval));
+
+    return (pool_t*) retval;
+}
+
+/**
+ * @brief Get the current frame arena. Allocations with #arena_alloc stay valid
+ * until the frame after next is shown, see #frame_arena_get.
+ */
+arena_t* frame_arena_get_user(void)
+{
+    uint32_t retval;
+
+    asm volatile("li $v0, 25");
+    asm volatile("syscall");
+
+    asm volatile("move %0, $t8" : "=r" (retval));
+
+    return (arena_t*) retval;
+}
+
 #endif
@@ -0,0 +1,84 @@
+/**
+ * @file arena.c
+ * @brief This module creates linear arenas, see arena_t, and manages the two frame arenas.
+ *
+ * Allocating, marking and rolling back is inline in arena.h, so that userspace can
+ * work on the frame arenas without going through a syscall for every allocation.
+ */
+
+#include "arena.h"
+#include "memory.h"
+#include "rdp.h"
+
+/** @brief Size of the arena header in front of the buffer, so that the buffer starts on a new cache line. */
+#define ARENA_HEADER_SIZE       ((sizeof(arena_t) + 15) & ~15)
+
+/** @brief The two frame arenas, created by the first #frame_arena_get. */
+static arena_t* __frame_arenas[2];
+/** @brief Index of the frame arena allocations currently go to. */
+static int __frame_current;
+/** @brief RDP fence of the last frame shown while each frame arena was current. Fence 0 is always done. */
+static uint32_t __frame_fences[2];
+
+/** @brief Fill in the header of an arena whose buffer directly follows it. */
+static arena_t* arena_init(void* block, uint32_t size)
+{
+    arena_t* arena = block;
+    if (arena != NULL)
+    {
+        arena->base = (uint8_t*) block + ARENA_HEADER_SIZE;
+        arena->size = size;
+        arena->used = 0;
+    }
+
+    return arena;
+}
+
+arena_t* arena_create(uint32_t size)
+{
+    if (size > 0xFFFFFFFF - ARENA_HEADER_SIZE)
+    {
+        return NULL;
+    }
+
+    return arena_init(malloc(ARENA_HEADER_SIZE + size), size);
+}
+
+void arena_destroy(arena_t* arena)
+{
+    free(arena);
+}
+
+arena_t* frame_arena_get(void)
+{
+    if (__frame_arenas[0] == NULL)
+    {
+        // The user segment can't give memory back, so allocate both or neither.
+        void* block = user_region_alloc(2 * (ARENA_HEADER_SIZE + FRAME_ARENA_SIZE));
+        if (block == NULL)
+        {
+            return NULL;
+        }
+
+        __frame_arenas[0] = arena_init(block, FRAME_ARENA_SIZE);
+        __frame_arenas[1] = arena_init((uint8_t*) block + ARENA_HEADER_SIZE + FRAME_ARENA_SIZE, FRAME_ARENA_SIZE);
+    }
+
+    return __frame_arenas[__frame_current];
+}
+
+void frame_arena_flip(uint32_t fence)
+{
+    if (__frame_arenas[0] == NULL)
+    {
+        return;
+    }
+
+    __frame_fences[__frame_current] = fence;
+    __frame_current ^= 1;
+
+    // The other arena was current for the frame before the one just shown. Its
+    // draw commands may still point into it, so they have to finish first.
+    rdp_wait_fence(__frame_fences[__frame_current]);
+    arena_reset(__frame_arenas[__frame_current]);
+}
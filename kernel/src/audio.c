@@ -81,18 +81,11 @@ void audio_init(int frequency)
 
     for(int i = 0; i < NUM_BUFFERS; i++)
     {
-        // 16-bit stereo buffers, interleaved, plus 8 bytes of padding.
-        __buffers[i] = malloc_uncached((2 * __buffer_size * sizeof(int16_t)) + 8);
-
-        // Workaround AI DMA hardware bug. If a buffer ends exactly
-        // at a 0x2000 address boundary, AI DMA gets confused because
-        // of a delayed internal carry. Since we allocated 8 bytes of padding,
-        // we can move our pointer a bit.
-        if (((uint32_t)(__buffers[i] + 2 * __buffer_size) & 0x1FFF) == 0)
-        {
-            __buffers[i] += 4;
-        }
-        
+        // 16-bit stereo buffers, interleaved. AI DMA reads them from RDRAM, 8-byte aligned.
+        int16_t* buffer = malloc_dma(2 * __buffer_size * sizeof(int16_t), 8, AI_DMA_BOUNDARY);
+        assert(buffer != NULL, "audio_init: Failed to allocate audio buffer.");
+        __buffers[i] = (int16_t*) ADDR_TO_KSEG1((uintptr_t) buffer);
+
         memset(__buffers[i], 0, 2 * __buffer_size * sizeof(int16_t));
     }
 
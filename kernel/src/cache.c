@@ -1,3 +1,6 @@
+#include "system.h"
+#include "cop0.h"
+
 #define CACHE_INST                      (0)
 #define CACHE_INST_SIZE                 (16 * 1024)
 #define CACHE_INST_LINESIZE             (32)
@@ -44,6 +47,55 @@ void data_cache_hit_writeback(volatile void* addr, unsigned long length)
     cache_op(addr, BUILD_CACHE_OP(HIT_WRITEBACK, CACHE_DATA), CACHE_DATA_LINESIZE, length);
 }
 
+void data_cache_writeback_invalidate_all(void)
+{
+    // Index ops only look at the address bits selecting the line, any KSEG0 address will do.
+    data_cache_index_writeback_invalidate((void*) MEM_KSEG0_BASE, CACHE_DATA_SIZE);
+}
+
+void data_cache_range_writeback(volatile void* addr, unsigned long length)
+{
+    // Past the size of the cache, walking every line of the range costs more than walking the cache itself.
+    if (length > CACHE_DATA_SIZE)
+    {
+        data_cache_writeback_invalidate_all();
+    }
+    else
+    {
+        data_cache_hit_writeback(addr, length);
+    }
+}
+
+void data_cache_range_writeback_invalidate(volatile void* addr, unsigned long length)
+{
+    if (length > CACHE_DATA_SIZE)
+    {
+        data_cache_writeback_invalidate_all();
+    }
+    else
+    {
+        data_cache_hit_writeback_invalidate(addr, length);
+    }
+}
+
+bool data_cache_range_resident(volatile void* addr, unsigned long length)
+{
+    uintptr_t end = (uintptr_t) addr + length;
+    for (uintptr_t line = (uintptr_t) addr & ~(CACHE_DATA_LINESIZE - 1); line < end; line += CACHE_DATA_LINESIZE)
+    {
+        // Index ops pick the line by the low address bits, the tag tells which memory it holds.
+        uintptr_t phys = ADDR_TO_PHYS(line);
+        asm volatile ("\tcache %0,(%1)\n"::"i" (BUILD_CACHE_OP(INDEX_LOAD_TAG, CACHE_DATA)), "r" (ADDR_TO_KSEG0(phys)));
+        uint32_t tag = C0_TAGLO();
+        if ((tag & C0_TAGLO_DATA_VALID) && (((tag & C0_TAGLO_PTAG) << 4) == (phys & ~0xFFF)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void inst_cache_index_invalidate(volatile void* addr, unsigned long length)
 {
     cache_op(addr, BUILD_CACHE_OP(INDEX_INVALIDATE, CACHE_INST), CACHE_INST_LINESIZE, length);
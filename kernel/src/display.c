@@ -3,30 +3,59 @@
 #include "graphics.h"
 #include "memory.h"
 #include "interrupt.h"
-
-/** @brief Maximum number of framebuffers. */
-#define NUM_BUFFERS         (2)
+#include "rdp.h"
+#include "cop0.h"
+#include "arena.h"
 
 /** @brief Width of currently active display. */
 static uint32_t __width;
 /** @brief Height of currently active display. */
 static uint32_t __height;
+/** @brief Number of framebuffers in use. */
+static int __num_buffers = 0;
+/** @brief How finished frames are put on screen. */
+static present_mode_t __present_mode = PRESENT_VSYNC;
 /** @brief Surface structs for display framebuffers. */
-static surface_t __surfaces[NUM_BUFFERS];
+static surface_t __surfaces[DISPLAY_MAX_BUFFERS];
 /** @brief Direct pointers to buffers. */
-static uint32_t* __buffers[NUM_BUFFERS];
+static void* __buffers[DISPLAY_MAX_BUFFERS];
 /** @brief Index of currently displayed buffer. */
 static int __now_showing = -1;
 /** @brief Bitmask of surfaces that are acquired to be drawn to. */
 static uint32_t __acquired_mask = 0;
 /** @brief Bitmask of surfaces that are pending to be displayed. */
 static uint32_t __pending_mask = 0;
+/** @brief RDP fence of each pending surface, it can't be scanned out before the RDP is done with it. */
+static uint32_t __fences[DISPLAY_MAX_BUFFERS];
+/** @brief Number of vblanks since #display_init. */
+static volatile uint32_t __vblank_count = 0;
+/** @brief Whether a new frame went on screen since the last vblank. */
+static bool __shown_new_frame = false;
+/** @brief Frame pacing counters. */
+static display_stats_t __stats;
+/** @brief Frames between ISViewer dumps of #__stats, 0 if disabled. */
+static int __stats_dump_interval = 0;
+/** @brief Frames left until the next dump. */
+static int __stats_dump_countdown = 0;
+/** @brief Counters at the time of the last dump. */
+static display_stats_t __stats_dumped;
+
+/**
+ * @brief Rectangles drawn to each framebuffer since its background was last restored.
+ *
+ * Every framebuffer has its own list because the buffers take turns: when a buffer
+ * is acquired again, its contents are the frame drawn into it one or more frames ago,
+ * not the frame that's currently on screen.
+ */
+static display_rect_t __dirty_rects[DISPLAY_MAX_BUFFERS][DISPLAY_MAX_DIRTY_RECTS];
+/** @brief Number of valid rectangles in #__dirty_rects, or -1 if the whole buffer is dirty. */
+static int __dirty_count[DISPLAY_MAX_BUFFERS];
 
 /** @brief Get the next buffer index (with wrap around). */
 static inline int __display_next_buffer(int id)
 {
     id++;
-    if (id == NUM_BUFFERS)
+    if (id == __num_buffers)
     {
         id = 0;
     }
@@ -37,23 +66,40 @@ static inline int __display_next_buffer(int id)
 /**
  * @brief Interrupt handler for vertical blank.
  *
- * If there is another frame to display, display the frame.
+ * If there is another frame to display and the RDP has finished drawing it,
+ * display the frame. Counts vblanks that had to show the previous frame again.
  */
 void __display_callback()
 {
-    int next = __display_next_buffer(__now_showing);
-    // Check if the next buffer is set to be displayed,
-    // otherwise just leave up the current frame.
-    if (__pending_mask & (1 << next))
+    __vblank_count++;
+    __stats.vblanks++;
+
+    if (__present_mode == PRESENT_VSYNC)
+    {
+        int next = __display_next_buffer(__now_showing);
+        // Check if the next buffer is set to be displayed and complete,
+        // otherwise just leave up the current frame.
+        if ((__pending_mask & (1 << next)) && rdp_fence_done(__fences[next]))
+        {
+            __now_showing = next;
+            __pending_mask &= ~(1 << next);
+            __shown_new_frame = true;
+        }
+    }
+
+    if (__shown_new_frame)
+    {
+        __shown_new_frame = false;
+    }
+    else if (__stats.presented > 0)
     {
-        __now_showing = next;
-        __pending_mask &= ~(1 << next);
+        __stats.repeated++;
     }
 
-    VI_regs->origin = (uint32_t) __buffers[__now_showing];
+    VI_regs->origin = (uintptr_t) __buffers[__now_showing];
 }
 
-void display_init(int width, int height, filter_t filter)
+void display_init(int width, int height, surface_format_t format, int num_buffers, present_mode_t present_mode, filter_t filter)
 {
     // Can't have the video interrupt happening here.
     interrupt_disable();
@@ -64,11 +110,25 @@ void display_init(int width, int height, filter_t filter)
     assert(width <= 640, "display_init: Heights > 640 don't make sense on real hardware.");
     assert(height <= 576, "display_init: Heights > 576 don't make sense on real hardware.");
     assert(width % 2 == 0, "display_init: Width must be divisible by 2 for 32-bit depth.");
+    assert(format != FMT_RGBA16 || width % 4 == 0, "display_init: Width must be divisible by 4 for 16-bit depth.");
+    assert(num_buffers >= 2 && num_buffers <= DISPLAY_MAX_BUFFERS, "display_init: Between 2 and 4 buffers are supported.");
+
+    __num_buffers = num_buffers;
+    __present_mode = present_mode;
 
     __width = width;
     __height = height;
 
-    uint32_t control = (VI_CTRL_TYPE_32_BPP | VI_CTRL_PIXEL_ADVANCE_DEFAULT);
+    uint32_t control = VI_CTRL_PIXEL_ADVANCE_DEFAULT;
+    if (format == FMT_RGBA16)
+    {
+        control |= VI_CTRL_TYPE_16_BPP;
+    }
+    else
+    {
+        control |= VI_CTRL_TYPE_32_BPP;
+    }
+
     if (filter == FILTER_NONE)
     {
         control |= VI_CTRL_AA_NONE;
@@ -79,23 +139,32 @@ void display_init(int width, int height, filter_t filter)
     }
 
     // Initialize buffers.
-    for (int i = 0; i < NUM_BUFFERS; i++ )
+    for (int i = 0; i < __num_buffers; i++ )
     {
-        __surfaces[i] = surface_alloc(__width, __height);
+        __surfaces[i] = surface_alloc(__width, __height, format);
         __buffers[i] = __surfaces[i].buffer;
         assert(__buffers[i] != NULL, "display_init: Failed to allocate display framebuffer.");
-        memset(__buffers[i], 0, __width * __height * sizeof(uint32_t));
+        memset(__buffers[i], 0, __width * __height * surface_bytes_per_pixel(format));
+    }
+
+    // Nothing has been drawn yet, but the background might not be black.
+    for (int i = 0; i < __num_buffers; i++ )
+    {
+        __dirty_count[i] = -1;
     }
 
     // Set the first buffer as the displaying buffer.
     __now_showing = 0;
     __acquired_mask = 0;
     __pending_mask = 0;
+    __shown_new_frame = false;
+    __stats = (display_stats_t) {.present_mode = present_mode};
+    __stats_dumped = __stats;
 
     // Wait for vblank.
     while(VI_regs->v_current != VI_V_CURRENT_VBLANK ) {  }
 
-    VI_regs->origin = (uint32_t) __buffers[0];
+    VI_regs->origin = (uintptr_t) __buffers[0];
     VI_regs->width = __width;
     VI_regs->x_scale = VI_X_SCALE_SET(__width, 640);
     VI_regs->y_scale = VI_Y_SCALE_SET(__height, 240);
@@ -107,7 +176,15 @@ void display_init(int width, int height, filter_t filter)
     interrupt_set_VI(true, VI_V_CURRENT_VBLANK);
 }
 
-static surface_t* display_try_get(void)
+void display_set_cached(bool cached)
+{
+    for (int i = 0; i < __num_buffers; i++ )
+    {
+        surface_set_cached(&__surfaces[i], cached);
+    }
+}
+
+surface_t* display_try_get(void)
 {
     surface_t* display = NULL;
 
@@ -122,6 +199,7 @@ static surface_t* display_try_get(void)
         {
             display = &__surfaces[next];
             __acquired_mask |= 1 << next;
+            __stats.acquired++;
             break;
         }
         next = __display_next_buffer(next);
@@ -134,16 +212,50 @@ static surface_t* display_try_get(void)
 
 surface_t* display_get(void)
 {
-    surface_t* display = NULL;
+    surface_t* display = display_try_get();
+    if (display != NULL)
+    {
+        return display;
+    }
 
+    uint32_t start = C0_COUNT();
     while (display == NULL)
     {
+        // Buffers only get released at vblank, so don't bother retrying before the next one.
+        uint32_t vblank = __vblank_count;
+        while (vblank == __vblank_count) {}
+
         display = display_try_get();
     }
+    uint32_t wait = C0_COUNT() - start;
+
+    interrupt_disable();
+    __stats.acquire_wait += wait;
+    if (wait > __stats.acquire_wait_max)
+    {
+        __stats.acquire_wait_max = wait;
+    }
+    interrupt_enable();
 
     return display;
 }
 
+/** @brief Write how the frame pacing counters changed since the last dump to ISViewer. */
+static void display_dump_stats(void)
+{
+    display_stats_t stats;
+    display_get_stats(&stats);
+
+    println_u32("display: frames presented: ", stats.presented - __stats_dumped.presented);
+    println_u32("display: frames dropped: ", stats.dropped - __stats_dumped.dropped);
+    println_u32("display: frames repeated: ", stats.repeated - __stats_dumped.repeated);
+    println_u32("display: vblanks: ", stats.vblanks - __stats_dumped.vblanks);
+    println_u32("display: acquire wait cycles: ", stats.acquire_wait - __stats_dumped.acquire_wait);
+    println_u32("display: acquire wait max cycles: ", stats.acquire_wait_max);
+
+    __stats_dumped = stats;
+}
+
 void display_show(surface_t* surface)
 {
     if (surface == NULL)
@@ -151,16 +263,149 @@ void display_show(surface_t* surface)
         return;
     }
 
+    // The VI must not scan out pixels still sitting in the data cache. The RDP
+    // doesn't draw into lines the CPU has dirtied, so this can overlap with it.
+    if (surface->flags & SURFACE_FLAGS_CACHED)
+    {
+        data_cache_range_writeback(surface->buffer, surface->width * surface->height * surface_bytes_per_pixel(surface->format));
+    }
+#ifdef KIVOS_DEBUG
+    else
+    {
+        assert(!data_cache_range_resident(surface->buffer, surface->width * surface->height * surface_bytes_per_pixel(surface->format)),
+               "display_show: Uncached surface was drawn to through the cache.");
+    }
+#endif
+
+    // Nor a frame the RDP is still drawing. Send its commands off and let the
+    // vblank handler check the fence, the CPU can go on with the next frame.
+    uint32_t fence = rdp_fence();
+
+    // Flipping right away leaves no later point to check the fence at.
+    if (__present_mode == PRESENT_LATEST)
+    {
+        rdp_wait_fence(fence);
+    }
+
     interrupt_disable();
 
     int i = surface - __surfaces;
 
-    assert(i >= 0 && i < NUM_BUFFERS, "display_show: Display address is not valid!");
+    assert(i >= 0 && i < __num_buffers, "display_show: Display address is not valid!");
     assert(!(__pending_mask & (1 << i)), "display_show: Called on the same display twice.");
     assert(__acquired_mask & (1 << i), "display_show: Called on a display not acquired first.");
 
     __acquired_mask &= ~(1 << i);
-    __pending_mask |= 1 << i;
+    __stats.presented++;
+
+    if (__present_mode == PRESENT_LATEST)
+    {
+        // Flip right away, even mid-scanout. If the previous frame hasn't
+        // been through a vblank yet, it never made it to the screen whole.
+        if (__shown_new_frame)
+        {
+            __stats.dropped++;
+        }
+        __now_showing = i;
+        __shown_new_frame = true;
+        VI_regs->origin = (uintptr_t) __buffers[__now_showing];
+    }
+    else
+    {
+        __fences[i] = fence;
+        __pending_mask |= 1 << i;
+    }
+
+    interrupt_enable();
+
+    // Data for the frame just shown stays valid until the next one is shown.
+    frame_arena_flip(fence);
+
+    if (__stats_dump_interval && (--__stats_dump_countdown == 0))
+    {
+        __stats_dump_countdown = __stats_dump_interval;
+        display_dump_stats();
+    }
+}
+
+/** @brief Get the index of a display surface, or -1 if it's not one. */
+static inline int display_index(surface_t* surface)
+{
+    int i = surface - __surfaces;
+    return (i >= 0 && i < __num_buffers) ? i : -1;
+}
+
+void display_mark_dirty(surface_t* surface, int x0, int y0, int x1, int y1)
+{
+    int i = display_index(surface);
+    if ((i < 0) || (__dirty_count[i] < 0) || (x0 >= x1) || (y0 >= y1))
+    {
+        return;
+    }
+
+    display_rect_t* rects = __dirty_rects[i];
+
+    // Grow an existing rectangle if the new one overlaps or touches it,
+    // sprites moving by a few pixels a frame mostly hit this case.
+    for (int r = 0; r < __dirty_count[i]; r++)
+    {
+        if ((x0 <= rects[r].x1) && (x1 >= rects[r].x0) && (y0 <= rects[r].y1) && (y1 >= rects[r].y0))
+        {
+            rects[r].x0 = (x0 < rects[r].x0) ? x0 : rects[r].x0;
+            rects[r].y0 = (y0 < rects[r].y0) ? y0 : rects[r].y0;
+            rects[r].x1 = (x1 > rects[r].x1) ? x1 : rects[r].x1;
+            rects[r].y1 = (y1 > rects[r].y1) ? y1 : rects[r].y1;
+            return;
+        }
+    }
+
+    // Out of space, give up and restore the whole buffer next time.
+    if (__dirty_count[i] == DISPLAY_MAX_DIRTY_RECTS)
+    {
+        __dirty_count[i] = -1;
+        return;
+    }
+
+    rects[__dirty_count[i]++] = (display_rect_t) {.x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1};
+}
 
+void display_mark_dirty_all(surface_t* surface)
+{
+    int i = display_index(surface);
+    if (i >= 0)
+    {
+        __dirty_count[i] = -1;
+    }
+}
+
+int display_take_dirty(surface_t* surface, display_rect_t* rects)
+{
+    int i = display_index(surface);
+    if (i < 0)
+    {
+        return -1;
+    }
+
+    int count = __dirty_count[i];
+    for (int r = 0; r < count; r++)
+    {
+        rects[r] = __dirty_rects[i][r];
+    }
+    __dirty_count[i] = 0;
+
+    return count;
+}
+
+void display_get_stats(display_stats_t* stats)
+{
+    interrupt_disable();
+    *stats = __stats;
     interrupt_enable();
 }
+
+void display_set_stats_dump(int interval)
+{
+    display_get_stats(&__stats_dumped);
+    __stats_dump_interval = (interval > 0) ? interval : 0;
+    __stats_dump_countdown = __stats_dump_interval;
+}
@@ -1,133 +1,1006 @@
 #include "graphics.h"
 #include "memory.h"
 #include "system.h"
+#include "rdp.h"
+#include "primitives.h"
+#include "lz4.h"
 
-surface_t surface_alloc(uint16_t width, uint16_t height)
+surface_t surface_alloc(uint16_t width, uint16_t height, surface_format_t format)
 {
     return (surface_t) {
         .width = width,
         .height = height,
-        .buffer = malloc_uncached(height * width * sizeof(uint32_t))
+        .buffer = malloc_uncached(surface_buffer_size(format, width, height)),
+        .format = format,
+        .flags = 0,
+        .palette = NULL
     };
 }
 
+surface_t surface_load_lz4(uint16_t width, uint16_t height, surface_format_t format, const void* blob, uint32_t blob_size)
+{
+    uint32_t size = surface_buffer_size(format, width, height);
+    if (lz4_decompressed_size(blob) != size)
+    {
+        return (surface_t) {.width = width, .height = height, .buffer = NULL, .format = format};
+    }
+
+    surface_t surface = surface_alloc(width, height, format);
+
+    // Decompress through the cache, the match copies read back what was just written.
+    void* kseg0 = (void*) ADDR_TO_KSEG0(ADDR_TO_PHYS((uintptr_t) surface.buffer));
+    int result = lz4_decompress(kseg0, size, blob, blob_size);
+    data_cache_range_writeback_invalidate(kseg0, size);
+
+    if (result < 0)
+    {
+        surface_free(surface);
+        surface.buffer = NULL;
+    }
+
+    return surface;
+}
+
 void surface_free(surface_t surface)
 {
+    // The RDP might still be drawing into or texturing from the memory about to be reused.
+    rdp_wait_surface(&surface);
+    free(surface.buffer);
+}
+
+void surface_set_cached(surface_t* surface, bool cached)
+{
+    if ((surface->buffer == NULL) || (!!(surface->flags & SURFACE_FLAGS_CACHED) == cached))
+    {
+        return;
+    }
+
+    // Don't switch under the RDP's feet.
+    rdp_wait();
+
+    uint32_t size = surface_buffer_size(surface->format, surface->width, surface->height);
+    uintptr_t kseg0 = ADDR_TO_KSEG0(ADDR_TO_PHYS((uintptr_t) surface->buffer));
+
+    if (cached)
+    {
+        // Drop stale lines from earlier cached use of the same memory.
+        data_cache_hit_invalidate((void*) kseg0, size);
+        surface->buffer = (void*) kseg0;
+        surface->flags |= SURFACE_FLAGS_CACHED;
+    }
+    else
+    {
+        data_cache_range_writeback_invalidate((void*) kseg0, size);
+        surface->buffer = (void*) ADDR_TO_KSEG1(kseg0);
+        surface->flags &= ~SURFACE_FLAGS_CACHED;
+    }
+}
+
+/** @brief Convert RGBA5551 color to RGBA32, replicating the top bits into the bottom ones. */
+static inline uint32_t color_from_rgba16(uint16_t color)
+{
+    uint32_t r = (color >> 11) & 0x1F;
+    uint32_t g = (color >>  6) & 0x1F;
+    uint32_t b = (color >>  1) & 0x1F;
+    uint32_t a = (color & 0x1) ? 0xFF : 0x00;
+    return RGBA32((r << 3) | (r >> 2), (g << 3) | (g >> 2), (b << 3) | (b >> 2), a);
+}
+
+/** @brief Look up a pixel of a color-indexed surface in its palette. */
+static inline uint32_t get_pixel_ci(surface_t* surface, int index)
+{
+    const uint8_t* indices = surface->buffer;
+    if (surface->format == FMT_CI8)
+    {
+        return surface->palette[indices[index]];
+    }
+
+    uint8_t pair = indices[index >> 1];
+    return surface->palette[(index & 1) ? (pair & 0xF) : (pair >> 4)];
+}
+
+/** @brief Read a pixel of any format as RGBA32. */
+static inline uint32_t get_pixel(surface_t* surface, int index)
+{
+    if (surface->format == FMT_RGBA16)
+    {
+        return color_from_rgba16(((uint16_t*) surface->buffer)[index]);
+    }
+    if (surface->format != FMT_RGBA32)
+    {
+        return get_pixel_ci(surface, index);
+    }
+
+    return ((uint32_t*) surface->buffer)[index];
 }
 
-static inline uint32_t get_pixel(uint32_t* buffer, int index)
-{
-    return buffer[index];
+/** @brief Write an RGBA32 pixel into a surface of any format. */
+static inline void draw_pixel(surface_t* surface, int index, uint32_t color)
+{
+    if (surface->format == FMT_RGBA16)
+    {
+        ((uint16_t*) surface->buffer)[index] = color_to_rgba16(color);
+        return;
+    }
+
+    ((uint32_t*) surface->buffer)[index] = color;
+}
+
+/** @brief Fill a run of 32-bit pixels, two pixels per 64-bit store. */
+static void fill_pixels32(uint32_t* dst, int count, uint32_t color)
+{
+    if ((count > 0) && ((uintptr_t) dst & 0x4))
+    {
+        *dst++ = color;
+        count--;
+    }
+
+    uint64_t color64 = ((uint64_t) color << 32) | color;
+    uint64_t* dst64 = (uint64_t*) dst;
+    while (count >= 2)
+    {
+        *dst64++ = color64;
+        count -= 2;
+    }
+
+    if (count)
+    {
+        *(uint32_t*) dst64 = color;
+    }
+}
+
+/** @brief Fill a run of 16-bit pixels, two pixels per 32-bit store and four per 64-bit store. */
+static void fill_pixels16(uint16_t* dst, int count, uint16_t color)
+{
+    uint32_t color32 = ((uint32_t) color << 16) | color;
+    uint64_t color64 = ((uint64_t) color32 << 32) | color32;
+
+    if ((count > 0) && ((uintptr_t) dst & 0x2))
+    {
+        *dst++ = color;
+        count--;
+    }
+    if ((count >= 2) && ((uintptr_t) dst & 0x4))
+    {
+        *(uint32_t*) dst = color32;
+        dst += 2;
+        count -= 2;
+    }
+
+    uint64_t* dst64 = (uint64_t*) dst;
+    while (count >= 4)
+    {
+        *dst64++ = color64;
+        count -= 4;
+    }
+
+    dst = (uint16_t*) dst64;
+    if (count >= 2)
+    {
+        *(uint32_t*) dst = color32;
+        dst += 2;
+        count -= 2;
+    }
+    if (count)
+    {
+        *dst = color;
+    }
+}
+
+static inline void copy_pixels32(uint32_t* dst, const uint32_t* src, int count)
+{
+    // Unrolled by 4 so the loop overhead doesn't dominate short runs.
+    while (count >= 4)
+    {
+        uint32_t c0 = src[0], c1 = src[1], c2 = src[2], c3 = src[3];
+        dst[0] = c0;
+        dst[1] = c1;
+        dst[2] = c2;
+        dst[3] = c3;
+        dst += 4;
+        src += 4;
+        count -= 4;
+    }
+    while (count--)
+    {
+        *dst++ = *src++;
+    }
+}
+
+/** @brief Copy a run of 16-bit pixels, using 64-bit accesses when source and destination alignment allows it. */
+static void copy_pixels16(uint16_t* dst, const uint16_t* src, int count)
+{
+    if (((((uintptr_t) dst) ^ ((uintptr_t) src)) & 0x7) == 0)
+    {
+        while ((count > 0) && ((uintptr_t) dst & 0x7))
+        {
+            *dst++ = *src++;
+            count--;
+        }
+
+        uint64_t* dst64 = (uint64_t*) dst;
+        const uint64_t* src64 = (const uint64_t*) src;
+        while (count >= 4)
+        {
+            *dst64++ = *src64++;
+            count -= 4;
+        }
+        dst = (uint16_t*) dst64;
+        src = (const uint16_t*) src64;
+    }
+
+    while (count--)
+    {
+        *dst++ = *src++;
+    }
+}
+
+/** @brief Pack two adjacent 16-bit pixels into a word, so that storing it puts them in memory order. */
+static inline uint32_t pack_pixels16(uint16_t first, uint16_t second)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Only host builds, the VR4300 runs big-endian.
+    return ((uint32_t) second << 16) | first;
+#else
+    return ((uint32_t) first << 16) | second;
+#endif
+}
+
+/** @brief Convert a run of RGBA32 pixels into RGBA16 pixels, two pixels per 32-bit store. */
+static void convert_pixels32_to_16(uint16_t* dst, const uint32_t* src, int count)
+{
+    if ((count > 0) && ((uintptr_t) dst & 0x2))
+    {
+        *dst++ = color_to_rgba16(*src++);
+        count--;
+    }
+
+    uint32_t* dst32 = (uint32_t*) dst;
+    while (count >= 2)
+    {
+        *dst32++ = pack_pixels16(color_to_rgba16(src[0]), color_to_rgba16(src[1]));
+        src += 2;
+        count -= 2;
+    }
+
+    if (count)
+    {
+        *(uint16_t*) dst32 = color_to_rgba16(*src);
+    }
+}
+
+/** @brief Convert a run of RGBA16 pixels into RGBA32 pixels. */
+static void convert_pixels16_to_32(uint32_t* dst, const uint16_t* src, int count)
+{
+    while (count--)
+    {
+        *dst++ = color_from_rgba16(*src++);
+    }
+}
+
+/** @brief Number of pixels expanded from a color-indexed surface at a time. */
+#define EXPAND_CHUNK    (64)
+
+/**
+ * @brief Expand a run of color-indexed pixels into RGBA32 through the palette.
+ *
+ * The palette is at most 1 KiB, so it stays in the data cache while a sprite is drawn.
+ */
+static void expand_pixels_ci(uint32_t* dst, const uint8_t* indices, int index, int count, const uint32_t* palette, bool ci4)
+{
+    if (!ci4)
+    {
+        indices += index;
+        for (int i = 0; i < count; i++)
+        {
+            dst[i] = palette[indices[i]];
+        }
+        return;
+    }
+
+    int i = 0;
+    // Align to a byte boundary first, then expand two pixels per byte.
+    if ((count > 0) && (index & 1))
+    {
+        dst[i++] = palette[indices[index >> 1] & 0xF];
+        index++;
+    }
+    indices += index >> 1;
+    for (; i + 1 < count; i += 2)
+    {
+        uint8_t pair = *indices++;
+        dst[i] = palette[pair >> 4];
+        dst[i + 1] = palette[pair & 0xF];
+    }
+    if (i < count)
+    {
+        dst[i] = palette[*indices >> 4];
+    }
+}
+
+/**
+ * @brief Scale 8-bit alpha (0-255) to 0-256, so that we can divide by shifting
+ * and fully opaque stays fully opaque.
+ */
+static inline uint32_t alpha_to_256(uint32_t alpha)
+{
+    return alpha + (alpha >> 7);
+}
+
+/**
+ * @brief Blend two colors using 8.8 fixed point math.
+ *
+ * Red and blue are processed together, each in its own 16-bit lane of a 32-bit word.
+ * A lane can hold at most 255 * 256, so the lanes never carry into each other.
+ */
+static inline uint32_t alphablend_pixel(uint32_t current_color, uint32_t drawn_color)
+{
+    uint32_t a = alpha_to_256(drawn_color & 0xFF);
+    uint32_t inv_a = 256 - a;
+
+    uint32_t rb = ((drawn_color >> 8) & 0x00FF00FF) * a + ((current_color >> 8) & 0x00FF00FF) * inv_a;
+    uint32_t g = ((drawn_color >> 16) & 0xFF) * a + ((current_color >> 16) & 0xFF) * inv_a;
+
+    return (rb & 0xFF00FF00) | ((g & 0xFF00) << 8) | 0xFF;
+}
+
+/**
+ * @brief Blend a premultiplied color on top of another color.
+ *
+ * Since the drawn color was already multiplied by its alpha, only the current color
+ * needs to be scaled, which leaves one multiply per channel.
+ */
+static inline uint32_t alphablend_pixel_premultiplied(uint32_t current_color, uint32_t drawn_color)
+{
+    uint32_t inv_a = 256 - alpha_to_256(drawn_color & 0xFF);
+
+    uint32_t rb = ((current_color >> 8) & 0x00FF00FF) * inv_a;
+    uint32_t g = ((current_color >> 16) & 0xFF) * inv_a;
+
+    return ((drawn_color & 0xFFFFFF00) + (rb & 0xFF00FF00) + ((g & 0xFF00) << 8)) | 0xFF;
+}
+
+/** @brief Blend a color on top of another color, either straight or premultiplied. */
+static inline uint32_t alphablend(uint32_t current_color, uint32_t drawn_color, bool premultiplied)
+{
+    return premultiplied ? alphablend_pixel_premultiplied(current_color, drawn_color) :
+                           alphablend_pixel(current_color, drawn_color);
+}
+
+/** @brief Alpha-blend a run of RGBA32 pixels into a 32-bit surface. */
+static void blend_pixels32(uint32_t* dst, const uint32_t* src, int count, bool premultiplied)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t src_color = src[i];
+        uint32_t alpha = src_color & 0xFF;
+        // Defer to basic drawing if color is fully opaque.
+        if (alpha == 0xFF)
+        {
+            dst[i] = src_color;
+        }
+        // Fully transparent pixels leave the destination as is.
+        else if (alpha != 0)
+        {
+            dst[i] = alphablend(dst[i], src_color, premultiplied);
+        }
+    }
+}
+
+/** @brief Alpha-blend a run of RGBA32 pixels into a 16-bit surface. */
+static void blend_pixels16(uint16_t* dst, const uint32_t* src, int count, bool premultiplied)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t src_color = src[i];
+        uint32_t alpha = src_color & 0xFF;
+        if (alpha == 0xFF)
+        {
+            dst[i] = color_to_rgba16(src_color);
+        }
+        else if (alpha != 0)
+        {
+            dst[i] = color_to_rgba16(alphablend(color_from_rgba16(dst[i]), src_color, premultiplied));
+        }
+    }
+}
+
+void graphics_fill_span(surface_t* surface, int x0, int x1, int y, uint32_t color)
+{
+    int index = x0 + (y * surface->width);
+
+    if (surface->format == FMT_RGBA16)
+    {
+        fill_pixels16((uint16_t*) surface->buffer + index, x1 - x0, color_to_rgba16(color));
+    }
+    else
+    {
+        fill_pixels32((uint32_t*) surface->buffer + index, x1 - x0, color);
+    }
+}
+
+void graphics_blend_span(surface_t* surface, int x0, int x1, int y, uint32_t color)
+{
+    uint32_t alpha = color & 0xFF;
+    if (alpha == 0xFF)
+    {
+        graphics_fill_span(surface, x0, x1, y, color);
+        return;
+    }
+    if (alpha == 0)
+    {
+        return;
+    }
+
+    // The color is the same for the whole span, so scale it only once.
+    uint32_t a = alpha_to_256(alpha);
+    uint32_t inv_a = 256 - a;
+    uint32_t rb_color = ((color >> 8) & 0x00FF00FF) * a;
+    uint32_t g_color = ((color >> 16) & 0xFF) * a;
+
+    int index = x0 + (y * surface->width);
+    for (int i = 0; i < x1 - x0; i++)
+    {
+        uint32_t current_color = get_pixel(surface, index + i);
+        uint32_t rb = rb_color + ((current_color >> 8) & 0x00FF00FF) * inv_a;
+        uint32_t g = g_color + ((current_color >> 16) & 0xFF) * inv_a;
+        draw_pixel(surface, index + i, (rb & 0xFF00FF00) | ((g & 0xFF00) << 8) | 0xFF);
+    }
+}
+
+void surface_premultiply(surface_t* surface)
+{
+    if ((surface->buffer == NULL) || (surface->flags & SURFACE_FLAGS_PREMULTIPLIED))
+    {
+        return;
+    }
+
+    // 16-bit surfaces only have 1-bit alpha, there is nothing to premultiply.
+    if (surface->format != FMT_RGBA32)
+    {
+        return;
+    }
+
+    uint32_t* buffer = surface->buffer;
+    for (int i = 0; i < surface->width * surface->height; i++)
+    {
+        uint32_t color = buffer[i];
+        uint32_t a = alpha_to_256(color & 0xFF);
+        uint32_t rb = (((color >> 8) & 0x00FF00FF) * a) & 0xFF00FF00;
+        uint32_t g = (((color >> 16) & 0xFF) * a) & 0xFF00;
+        buffer[i] = rb | (g << 8) | (color & 0xFF);
+    }
+
+    surface->flags |= SURFACE_FLAGS_PREMULTIPLIED;
+}
+
+/** @brief Fill a rectangle that lies entirely within the surface. */
+static void fill_rect(surface_t* surface, int x0, int y0, int x1, int y1, uint32_t color)
+{
+    // Let the RDP do it if it can.
+    if (rdp_can_target(surface))
+    {
+        rdp_fill_rectangle(surface, x0, y0, x1, y1, color);
+        return;
+    }
+
+    // Don't race with the RDP.
+    rdp_wait_surface(surface);
+
+    // Full-width rectangles are contiguous in memory.
+    if ((x0 == 0) && (x1 == surface->width))
+    {
+        x1 = surface->width * (y1 - y0);
+        y1 = y0 + 1;
+    }
+
+    uint16_t color16 = color_to_rgba16(color);
+    for (int y = y0; y < y1; y++)
+    {
+        int index = x0 + (y * surface->width);
+        if (surface->format == FMT_RGBA16)
+        {
+            fill_pixels16((uint16_t*) surface->buffer + index, x1 - x0, color16);
+        }
+        else
+        {
+            fill_pixels32((uint32_t*) surface->buffer + index, x1 - x0, color);
+        }
+    }
+}
+
+void graphics_fill(surface_t* surface, uint32_t color)
+{
+    if (surface->buffer == NULL)
+    {
+        return;
+    }
+
+    display_mark_dirty_all(surface);
+    fill_rect(surface, 0, 0, surface->width, surface->height, color);
+}
+
+void graphics_fill_rect(surface_t* surface, int x, int y, int width, int height, uint32_t color)
+{
+    if (surface->buffer == NULL)
+    {
+        return;
+    }
+
+    int x0 = (x > 0) ? x : 0;
+    int y0 = (y > 0) ? y : 0;
+    int x1 = (x + width < surface->width) ? (x + width) : surface->width;
+    int y1 = (y + height < surface->height) ? (y + height) : surface->height;
+
+    if ((x0 >= x1) || (y0 >= y1))
+    {
+        return;
+    }
+
+    display_mark_dirty(surface, x0, y0, x1, y1);
+    fill_rect(surface, x0, y0, x1, y1, color);
+}
+
+void graphics_restore_background(surface_t* surface, uint32_t color)
+{
+    if (surface->buffer == NULL)
+    {
+        return;
+    }
+
+    display_rect_t rects[DISPLAY_MAX_DIRTY_RECTS];
+    int count = display_take_dirty(surface, rects);
+
+    if (count < 0)
+    {
+        fill_rect(surface, 0, 0, surface->width, surface->height, color);
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        fill_rect(surface, rects[i].x0, rects[i].y0, rects[i].x1, rects[i].y1, color);
+    }
+}
+
+void graphics_draw_pixel(surface_t* surface, int x, int y, uint32_t color)
+{
+    if (surface->buffer == NULL)
+    {
+        return;
+    }
+
+    rdp_wait_surface(surface);
+
+    display_mark_dirty(surface, x, y, x + 1, y + 1);
+    draw_pixel(surface, x + (y * surface->width), color);
+}
+
+void graphics_draw_pixel_alpha(surface_t* surface, int x, int y, uint32_t color)
+{
+    if (surface->buffer == NULL)
+    {
+        return;
+    }
+
+    rdp_wait_surface(surface);
+
+    display_mark_dirty(surface, x, y, x + 1, y + 1);
+    int index = x + (y * surface->width);
+
+    // Defer to basic drawing if color is fully opaque.
+    if ((color & 0xFF) == 0xFF)
+    {
+        draw_pixel(surface, index, color);
+        return;
+    }
+
+    uint32_t current_color = get_pixel(surface, index);
+    uint32_t new_color = alphablend_pixel(current_color, color);
+    draw_pixel(surface, index, new_color);
+}
+
+clip_area_t graphics_clip(surface_t* dst, int x, int y, int width, int height)
+{
+    // Source surface bounds.
+    int start_x = 0;
+    int start_y = 0;
+    int end_x = width;
+    int end_y = height;
+
+    // Clip left.
+    if (x < 0)
+    {
+        start_x += (x * -1);
+    }
+    // Clip top.
+    if (y < 0)
+    {
+        start_y += (y * -1);
+    }
+    // Clip right.
+    if ((x + end_x) >= (int) dst->width)
+    {
+        end_x = dst->width - x;
+    }
+    // Clipbottom.
+    if ((y + end_y) >= (int) dst->height)
+    {
+        end_y = dst->height - y;
+    }
+
+    return (clip_area_t) {.x_start = start_x, .y_start = start_y, .x_end = end_x, .y_end = end_y};
+}
+
+void graphics_copy_pixels(surface_t* dst, int dst_index, surface_t* src, int src_index, int count)
+{
+    if ((src->format == FMT_CI8) || (src->format == FMT_CI4))
+    {
+        uint32_t colors[EXPAND_CHUNK];
+        while (count > 0)
+        {
+            int chunk = (count < EXPAND_CHUNK) ? count : EXPAND_CHUNK;
+            expand_pixels_ci(colors, src->buffer, src_index, chunk, src->palette, src->format == FMT_CI4);
+            if (dst->format == FMT_RGBA16)
+            {
+                convert_pixels32_to_16((uint16_t*) dst->buffer + dst_index, colors, chunk);
+            }
+            else
+            {
+                copy_pixels32((uint32_t*) dst->buffer + dst_index, colors, chunk);
+            }
+            dst_index += chunk;
+            src_index += chunk;
+            count -= chunk;
+        }
+        return;
+    }
+
+    if (dst->format == FMT_RGBA16)
+    {
+        uint16_t* dst_pixels = (uint16_t*) dst->buffer + dst_index;
+        if (src->format == FMT_RGBA16)
+        {
+            copy_pixels16(dst_pixels, (uint16_t*) src->buffer + src_index, count);
+        }
+        else
+        {
+            convert_pixels32_to_16(dst_pixels, (uint32_t*) src->buffer + src_index, count);
+        }
+    }
+    else
+    {
+        uint32_t* dst_pixels = (uint32_t*) dst->buffer + dst_index;
+        if (src->format == FMT_RGBA16)
+        {
+            convert_pixels16_to_32(dst_pixels, (uint16_t*) src->buffer + src_index, count);
+        }
+        else
+        {
+            copy_pixels32(dst_pixels, (uint32_t*) src->buffer + src_index, count);
+        }
+    }
+}
+
+void graphics_draw_surface(surface_t* dst, int x, int y, surface_t* src)
+{
+    // Sanity checking
+    if (dst->buffer == NULL)
+    {
+        return;
+    }
+    if (src->buffer == NULL)
+    {
+        return;
+    }
+
+    // Exit early if all drawing would go off-surface.
+    if (((x + (int) src->width) <= 0) ||
+        ((y + (int) src->height) <= 0) ||
+        (x >= (int) dst->width) ||
+        (y >= (int) dst->height))
+    {
+        return;
+    }
+
+    clip_area_t clip_area = graphics_clip(dst, x, y, src->width, src->height);
+    display_mark_dirty(dst, x + clip_area.x_start, y + clip_area.y_start, x + clip_area.x_end, y + clip_area.y_end);
+
+    rdp_wait_surface(dst);
+    rdp_wait_surface(src);
+
+    int count = clip_area.x_end - clip_area.x_start;
+
+    for (int src_row = clip_area.y_start; src_row < clip_area.y_end; src_row++ )
+    {
+        int src_index = clip_area.x_start + (src_row * src->width);
+        int dst_index = (x + clip_area.x_start) + ((y + src_row) * dst->width);
+
+        graphics_copy_pixels(dst, dst_index, src, src_index, count);
+    }
 }
 
-static inline void draw_pixel(uint32_t* buffer, int index, uint32_t color)
+void graphics_draw_surface_alpha(surface_t* dst, int x, int y, surface_t* src)
 {
-    buffer[index] = color;
+    graphics_draw_surface_region_alpha(dst, x, y, src, 0, 0, src->width, src->height);
 }
 
-static uint32_t alphablend_pixel(uint32_t current_color, uint32_t drawn_color)
+void graphics_draw_surface_region_alpha(surface_t* dst, int x, int y, surface_t* src, int src_x, int src_y, int width, int height)
 {
-    uint8_t current_r = (current_color >> 24) & 0xFF;
-    uint8_t current_g = (current_color >> 16) & 0xFF;
-    uint8_t current_b = (current_color >>  8) & 0xFF;
+    // Sanity checking
+    if (dst->buffer == NULL)
+    {
+        return;
+    }
+    if (src->buffer == NULL)
+    {
+        return;
+    }
 
-    uint8_t r = (drawn_color >> 24) & 0xFF;
-    uint8_t g = (drawn_color >> 16) & 0xFF;
-    uint8_t b = (drawn_color >>  8) & 0xFF;
-    float a = (drawn_color & 0xFF) / 255.0f;
+    // Keep the region inside the source, the pixels that remain stay where they were.
+    if (src_x < 0)
+    {
+        x -= src_x;
+        width += src_x;
+        src_x = 0;
+    }
+    if (src_y < 0)
+    {
+        y -= src_y;
+        height += src_y;
+        src_y = 0;
+    }
+    if (width > (int) src->width - src_x)
+    {
+        width = (int) src->width - src_x;
+    }
+    if (height > (int) src->height - src_y)
+    {
+        height = (int) src->height - src_y;
+    }
+    if ((width <= 0) || (height <= 0))
+    {
+        return;
+    }
+
+    // Exit early if all drawing would go off-surface.
+    if (((x + width) <= 0) ||
+        ((y + height) <= 0) ||
+        (x >= (int) dst->width) ||
+        (y >= (int) dst->height))
+    {
+        return;
+    }
 
-    uint8_t new_r = (r - current_r) * a + current_r;
-    uint8_t new_g = (g - current_g) * a + current_g;
-    uint8_t new_b = (b - current_b) * a + current_b;
+    // Make sure we touch src data in kernel segment, through its own pointer if it's uncached.
+    void* src_buffer = (void*) ADDR_USER_TO_KERNEL((uintptr_t) src->buffer);
 
-    return RGBA32(new_r, new_g, new_b, 0xFF);
-}
+    clip_area_t clip_area = graphics_clip(dst, x, y, width, height);
+    display_mark_dirty(dst, x + clip_area.x_start, y + clip_area.y_start, x + clip_area.x_end, y + clip_area.y_end);
 
-void graphics_fill(surface_t* surface, uint32_t color)
-{
-    if (surface->buffer == NULL)
+    // Let the RDP do it if it can. Its blender can't do premultiplied alpha in one cycle.
+    if (rdp_can_target(dst) && rdp_can_texture(src) && !(src->flags & SURFACE_FLAGS_PREMULTIPLIED))
     {
+        rdp_draw_surface_alpha(dst, x - src_x, y - src_y, src, src_x + clip_area.x_start, src_y + clip_area.y_start,
+                               src_x + clip_area.x_end, src_y + clip_area.y_end);
         return;
     }
 
-    for (int i = 0; i < surface->width * surface->height; i++)
+    // Don't race with the RDP.
+    rdp_wait_surface(dst);
+    rdp_wait_surface(src);
+
+    bool premultiplied = src->flags & SURFACE_FLAGS_PREMULTIPLIED;
+    int count = clip_area.x_end - clip_area.x_start;
+    const uint32_t* palette = (const uint32_t*) ADDR_USER_TO_KERNEL((uintptr_t) src->palette);
+
+    for (int row = clip_area.y_start; row < clip_area.y_end; row++ )
     {
-        draw_pixel(surface->buffer, i, color);
+        int src_index = (src_x + clip_area.x_start) + ((src_y + row) * src->width);
+        int dst_index = (x + clip_area.x_start) + ((y + row) * dst->width);
+
+        if ((src->format == FMT_CI8) || (src->format == FMT_CI4))
+        {
+            // Expand through the palette, then blend like an RGBA32 source.
+            uint32_t colors[EXPAND_CHUNK];
+            for (int i = 0; i < count; i += EXPAND_CHUNK)
+            {
+                int chunk = (count - i < EXPAND_CHUNK) ? (count - i) : EXPAND_CHUNK;
+                expand_pixels_ci(colors, src_buffer, src_index + i, chunk, palette, src->format == FMT_CI4);
+                if (dst->format == FMT_RGBA16)
+                {
+                    blend_pixels16((uint16_t*) dst->buffer + dst_index + i, colors, chunk, premultiplied);
+                }
+                else
+                {
+                    blend_pixels32((uint32_t*) dst->buffer + dst_index + i, colors, chunk, premultiplied);
+                }
+            }
+        }
+        else if (src->format == FMT_RGBA16)
+        {
+            // 1-bit alpha: pixels are either fully opaque or fully transparent.
+            const uint16_t* src_pixels = (const uint16_t*) src_buffer + src_index;
+            for (int i = 0; i < count; i++)
+            {
+                if (src_pixels[i] & 0x1)
+                {
+                    draw_pixel(dst, dst_index + i, color_from_rgba16(src_pixels[i]));
+                }
+            }
+        }
+        else if (dst->format == FMT_RGBA16)
+        {
+            blend_pixels16((uint16_t*) dst->buffer + dst_index, (const uint32_t*) src_buffer + src_index, count, premultiplied);
+        }
+        else
+        {
+            blend_pixels32((uint32_t*) dst->buffer + dst_index, (const uint32_t*) src_buffer + src_index, count, premultiplied);
+        }
     }
 }
 
-void graphics_draw_pixel(surface_t* surface, int x, int y, uint32_t color)
+/** @brief Draw one pixel with the alpha rules of graphics_draw_surface_alpha. */
+static inline void blit_pixel(surface_t* dst, int index, uint32_t color, bool premultiplied)
 {
-    if (surface->buffer == NULL)
+    uint32_t alpha = color & 0xFF;
+    if (alpha == 0xFF)
     {
-        return;
+        draw_pixel(dst, index, color);
+    }
+    else if (alpha != 0)
+    {
+        draw_pixel(dst, index, alphablend(get_pixel(dst, index), color, premultiplied));
     }
-
-    draw_pixel(surface->buffer, x + (y * surface->width), color);
 }
 
-void graphics_draw_pixel_alpha(surface_t* surface, int x, int y, uint32_t color)
+/** @brief Draw a run of one repeated pixel with the alpha rules of graphics_draw_surface_alpha. */
+static void blit_run(surface_t* dst, int x0, int x1, int y, uint32_t color, bool premultiplied)
 {
-    if (surface->buffer == NULL)
+    uint32_t alpha = color & 0xFF;
+    if (!premultiplied || (alpha == 0xFF) || (alpha == 0))
     {
+        graphics_blend_span(dst, x0, x1, y, color);
         return;
     }
 
-    int index = x + (y * surface->width);
+    int index = x0 + (y * dst->width);
+    for (int i = 0; i < x1 - x0; i++)
+    {
+        draw_pixel(dst, index + i, alphablend_pixel_premultiplied(get_pixel(dst, index + i), color));
+    }
+}
 
-    // Defer to basic drawing if color is fully opaque.
-    if ((color & 0xFF) == 0xFF)
+/** @brief Sine accurate to about 1e-4, the kernel has no math library. */
+static float blit_sin(float angle)
+{
+    const float pi = 3.14159265f;
+
+    // Reduce to [-pi, pi], then fold into [-pi/2, pi/2] using sin(pi - a) = sin(a).
+    angle -= (2.0f * pi) * (float) (int) (angle / (2.0f * pi));
+    if (angle > pi)
     {
-        draw_pixel(surface->buffer, index, color);
-        return;
+        angle -= 2.0f * pi;
+    }
+    else if (angle < -pi)
+    {
+        angle += 2.0f * pi;
+    }
+    if (angle > pi / 2.0f)
+    {
+        angle = pi - angle;
+    }
+    else if (angle < -pi / 2.0f)
+    {
+        angle = -pi - angle;
     }
 
-    uint32_t current_color = get_pixel(surface->buffer, index);
-    uint32_t new_color = alphablend_pixel(current_color, color);
-    draw_pixel(surface->buffer, index, new_color);
+    float a2 = angle * angle;
+    return angle * (1.0f - a2 / 6.0f * (1.0f - a2 / 20.0f * (1.0f - a2 / 42.0f)));
 }
 
-typedef struct clip_area_s
+/** @brief Round a float down to an integer. */
+static inline int blit_floor(float value)
 {
-    int x_start;
-    int y_start;
-    int x_end;
-    int y_end;
-} clip_area_t;
+    int i = (int) value;
+    return (value < (float) i) ? (i - 1) : i;
+}
 
-static clip_area_t clip_surface(surface_t* dst, int x, int y, surface_t* src)
+/** @brief Divide, rounding towards negative infinity. The divisor must be positive. */
+static inline int floor_div(int a, int b)
 {
-    // Source surface bounds.
-    int start_x = 0;
-    int start_y = 0;
-    int end_x = src->width;
-    int end_y = src->height;
+    return (a >= 0) ? (a / b) : -((b - 1 - a) / b);
+}
 
-    // Clip left.
-    if (x < 0)
+/**
+ * @brief Narrow the step range [*t0, *t1) to the steps where a 16.16 coordinate
+ * start + step * t stays within [0, limit).
+ */
+static void blit_limit(int start, int step, int limit, int* t0, int* t1)
+{
+    int lo, hi;
+    if (step > 0)
     {
-        start_x += (x * -1);
+        lo = -floor_div(start, step);
+        hi = floor_div(limit - 1 - start, step) + 1;
     }
-    // Clip top.
-    if (y < 0)
+    else if (step < 0)
     {
-        start_y += (y * -1);
+        lo = -floor_div(limit - 1 - start, -step);
+        hi = floor_div(start, -step) + 1;
     }
-    // Clip right.
-    if ((x + end_x) >= (int) dst->width)
+    else
     {
-        end_x = dst->width - x;
+        lo = *t0;
+        hi = ((start >= 0) && (start < limit)) ? *t1 : *t0;
     }
-    // Clipbottom.
-    if ((y + end_y) >= (int) dst->height)
+
+    *t0 = (lo > *t0) ? lo : *t0;
+    *t1 = (hi < *t1) ? hi : *t1;
+}
+
+/**
+ * @brief Nearest-neighbour blit for integer scales without rotation.
+ *
+ * Every source pixel covers a scale_x * scale_y block of the destination, so each
+ * one is written as a run of duplicated pixels. Negative scales flip the region.
+ */
+static void blit_integer_scale(surface_t* dst, int x, int y, surface_t* texture, const blit_params_t* params,
+                               int width, int height, int scale_x, int scale_y, int x0, int y0, int x1, int y1)
+{
+    bool premultiplied = texture->flags & SURFACE_FLAGS_PREMULTIPLIED;
+
+    for (int row = 0; row < height; row++)
     {
-        end_y = dst->height - y;
-    }
+        int row_y0 = y + (row - params->pivot_y) * scale_y;
+        int row_y1 = row_y0 + scale_y;
+        if (scale_y < 0)
+        {
+            int tmp = row_y0;
+            row_y0 = row_y1;
+            row_y1 = tmp;
+        }
+        row_y0 = (row_y0 > y0) ? row_y0 : y0;
+        row_y1 = (row_y1 < y1) ? row_y1 : y1;
+        if (row_y0 >= row_y1)
+        {
+            continue;
+        }
 
-    return (clip_area_t) {.x_start = start_x, .y_start = start_y, .x_end = end_x, .y_end = end_y};
+        int src_index = params->src_x + ((params->src_y + row) * texture->width);
+
+        for (int col = 0; col < width; col++)
+        {
+            uint32_t color = get_pixel(texture, src_index + col);
+            if ((color & 0xFF) == 0)
+            {
+                continue;
+            }
+
+            int run_x0 = x + (col - params->pivot_x) * scale_x;
+            int run_x1 = run_x0 + scale_x;
+            if (scale_x < 0)
+            {
+                int tmp = run_x0;
+                run_x0 = run_x1;
+                run_x1 = tmp;
+            }
+            run_x0 = (run_x0 > x0) ? run_x0 : x0;
+            run_x1 = (run_x1 < x1) ? run_x1 : x1;
+            if (run_x0 >= run_x1)
+            {
+                continue;
+            }
+
+            for (int dst_y = row_y0; dst_y < row_y1; dst_y++)
+            {
+                blit_run(dst, run_x0, run_x1, dst_y, color, premultiplied);
+            }
+        }
+    }
 }
 
-void graphics_draw_surface(surface_t* dst, int x, int y, surface_t* src)
+void graphics_draw_surface_transformed(surface_t* dst, int x, int y, surface_t* src, const blit_params_t* params)
 {
     // Sanity checking
     if (dst->buffer == NULL)
@@ -138,75 +1011,537 @@ void graphics_draw_surface(surface_t* dst, int x, int y, surface_t* src)
     {
         return;
     }
+    if ((params->scale_x == 0.0f) || (params->scale_y == 0.0f))
+    {
+        return;
+    }
+
+    // Make sure we touch src data in kernel segment, through its own pointer if it's uncached.
+    surface_t texture = *src;
+    texture.buffer = (void*) ADDR_USER_TO_KERNEL((uintptr_t) src->buffer);
+    texture.palette = (const uint32_t*) ADDR_USER_TO_KERNEL((uintptr_t) src->palette);
+
+    // The region must start inside the source. Its size defaults to, and is clamped
+    // to, the rest of the source.
+    if ((params->src_x < 0) || (params->src_y < 0) || (params->src_x >= (int) src->width) || (params->src_y >= (int) src->height))
+    {
+        return;
+    }
+    int width = (int) src->width - params->src_x;
+    int height = (int) src->height - params->src_y;
+    if (params->width && (params->width < width))
+    {
+        width = params->width;
+    }
+    if (params->height && (params->height < height))
+    {
+        height = params->height;
+    }
+    float scale_x = (params->flags & BLIT_FLIP_X) ? -params->scale_x : params->scale_x;
+    float scale_y = (params->flags & BLIT_FLIP_Y) ? -params->scale_y : params->scale_y;
+
+    // Keep the unrotated case exact, the integer scale fast path relies on it.
+    float sin_a = 0.0f;
+    float cos_a = 1.0f;
+    if (params->angle != 0.0f)
+    {
+        sin_a = blit_sin(params->angle);
+        cos_a = blit_sin(params->angle + 3.14159265f / 2.0f);
+    }
+
+    // Destination bounding box of the transformed region corners.
+    float min_x = 0.0f, min_y = 0.0f, max_x = 0.0f, max_y = 0.0f;
+    for (int i = 0; i < 4; i++)
+    {
+        float u = (float) (((i & 1) ? width : 0) - params->pivot_x) * scale_x;
+        float v = (float) (((i & 2) ? height : 0) - params->pivot_y) * scale_y;
+        float corner_x = cos_a * u - sin_a * v;
+        float corner_y = sin_a * u + cos_a * v;
+        min_x = ((i == 0) || (corner_x < min_x)) ? corner_x : min_x;
+        max_x = ((i == 0) || (corner_x > max_x)) ? corner_x : max_x;
+        min_y = ((i == 0) || (corner_y < min_y)) ? corner_y : min_y;
+        max_y = ((i == 0) || (corner_y > max_y)) ? corner_y : max_y;
+    }
+
+    int x0 = x + blit_floor(min_x);
+    int y0 = y + blit_floor(min_y);
+    int x1 = x - blit_floor(-max_x);
+    int y1 = y - blit_floor(-max_y);
+    x0 = (x0 > 0) ? x0 : 0;
+    y0 = (y0 > 0) ? y0 : 0;
+    x1 = (x1 < dst->width) ? x1 : dst->width;
+    y1 = (y1 < dst->height) ? y1 : dst->height;
 
     // Exit early if all drawing would go off-surface.
-    if (((x + (int) src->width) <= 0) ||
-        ((y + (int) src->height) <= 0) ||
-        (x >= (int) dst->width) ||
-        (y >= (int) dst->height))
+    if ((x0 >= x1) || (y0 >= y1))
     {
         return;
     }
 
-    clip_area_t clip_area = clip_surface(dst, x, y, src);
+    display_mark_dirty(dst, x0, y0, x1, y1);
 
-    for (int src_row = clip_area.y_start; src_row < clip_area.y_end; src_row++ )
+    // Don't race with the RDP.
+    rdp_wait_surface(dst);
+    rdp_wait_surface(src);
+
+    if ((params->angle == 0.0f) && (scale_x == (float) (int) scale_x) && (scale_y == (float) (int) scale_y))
+    {
+        blit_integer_scale(dst, x, y, &texture, params, width, height, (int) scale_x, (int) scale_y, x0, y0, x1, y1);
+        return;
+    }
+
+    // Inverse transform in 16.16 fixed point: moving one pixel right or down on dst
+    // moves by a constant step on src.
+    int du_dx = (int) (cos_a / scale_x * 65536.0f);
+    int dv_dx = (int) (-sin_a / scale_y * 65536.0f);
+    int du_dy = (int) (sin_a / scale_x * 65536.0f);
+    int dv_dy = (int) (cos_a / scale_y * 65536.0f);
+
+    // Source coordinates of the first pixel center of the bounding box.
+    float dx = (float) (x0 - x) + 0.5f;
+    float dy = (float) (y0 - y) + 0.5f;
+    int u_row = (int) (((float) params->pivot_x + (cos_a * dx + sin_a * dy) / scale_x) * 65536.0f);
+    int v_row = (int) (((float) params->pivot_y + (cos_a * dy - sin_a * dx) / scale_y) * 65536.0f);
+
+    bool premultiplied = src->flags & SURFACE_FLAGS_PREMULTIPLIED;
+
+    for (int row = y0; row < y1; row++, u_row += du_dy, v_row += dv_dy)
     {
-        int y_index = src_row * src->width;
+        // Only the part of the row that maps inside the source region gets drawn,
+        // which leaves no bounds checks for the inner loop.
+        int t0 = 0;
+        int t1 = x1 - x0;
+        blit_limit(u_row, du_dx, width << 16, &t0, &t1);
+        blit_limit(v_row, dv_dx, height << 16, &t0, &t1);
 
-        for (int src_col = clip_area.x_start; src_col < clip_area.x_end; src_col++ )
+        int u = u_row + t0 * du_dx;
+        int v = v_row + t0 * dv_dx;
+        int dst_index = x0 + (row * dst->width);
+
+        for (int t = t0; t < t1; t++, u += du_dx, v += dv_dx)
         {
-            int index = (x + src_col) + ((y + src_row) * dst->width);
-            draw_pixel(dst->buffer, index, get_pixel(src->buffer, y_index + src_col));
+            int src_index = (params->src_x + (u >> 16)) + ((params->src_y + (v >> 16)) * src->width);
+            blit_pixel(dst, dst_index + t, get_pixel(&texture, src_index), premultiplied);
         }
     }
 }
 
-void graphics_draw_surface_alpha(surface_t* dst, int x, int y, surface_t* src)
+void graphics_draw_sprite_rle(surface_t* dst, int x, int y, const sprite_rle_t* sprite)
 {
     // Sanity checking
     if (dst->buffer == NULL)
     {
         return;
     }
-    if (src->buffer == NULL)
+    if (sprite == NULL)
     {
         return;
     }
 
+    // Make sure we touch sprite data in kernel segment.
+    sprite = (const sprite_rle_t*) ADDR_TO_KSEG0((uintptr_t) sprite);
+
     // Exit early if all drawing would go off-surface.
-    if (((x + (int) src->width) <= 0) ||
-        ((y + (int) src->height) <= 0) ||
+    if (((x + (int) sprite->width) <= 0) ||
+        ((y + (int) sprite->height) <= 0) ||
         (x >= (int) dst->width) ||
         (y >= (int) dst->height))
     {
         return;
     }
 
-    // Make sure we touch src data in kernel segment.
-    uint32_t* src_buffer = (uint32_t*) ADDR_TO_KSEG0((uint32_t) src->buffer);
+    clip_area_t clip_area = graphics_clip(dst, x, y, sprite->width, sprite->height);
+    display_mark_dirty(dst, x + clip_area.x_start, y + clip_area.y_start, x + clip_area.x_end, y + clip_area.y_end);
 
-    clip_area_t clip_area = clip_surface(dst, x, y, src);
+    // Don't race with the RDP.
+    rdp_wait_surface(dst);
+
+    bool premultiplied = sprite->flags & SURFACE_FLAGS_PREMULTIPLIED;
 
     for (int src_row = clip_area.y_start; src_row < clip_area.y_end; src_row++ )
     {
-        int y_index = src_row * src->width;
+        const uint16_t* row = (const uint16_t*) ((const uint8_t*) sprite + sprite->row_offsets[src_row]);
+        int span_count = row[0];
+        const sprite_rle_span_t* spans = (const sprite_rle_span_t*) (row + 1);
+        const uint32_t* pixels = (const uint32_t*) (((uintptr_t) (spans + span_count) + 3) & ~3);
+        int dst_index = x + ((y + src_row) * dst->width);
 
-        for (int src_col = clip_area.x_start; src_col < clip_area.x_end; src_col++ )
+        int src_col = 0;
+        for (int i = 0; (i < span_count) && (src_col < clip_area.x_end); i++)
         {
-            int index = (x + src_col) + ((y + src_row) * dst->width);
-            uint32_t src_color = get_pixel(src_buffer, y_index + src_col);
-            // Defer to basic drawing if color is fully opaque.
-            if ((src_color & 0xFF) == 0xFF)
+            src_col += spans[i].skip;
+
+            // Clip the opaque run and copy it.
+            int start = (src_col > clip_area.x_start) ? src_col : clip_area.x_start;
+            int end = src_col + spans[i].opaque;
+            end = (end < clip_area.x_end) ? end : clip_area.x_end;
+            if (start < end)
             {
-                draw_pixel(dst->buffer, index, src_color);
+                if (dst->format == FMT_RGBA16)
+                {
+                    convert_pixels32_to_16((uint16_t*) dst->buffer + dst_index + start, pixels + (start - src_col), end - start);
+                }
+                else
+                {
+                    copy_pixels32((uint32_t*) dst->buffer + dst_index + start, pixels + (start - src_col), end - start);
+                }
             }
-            else
+            pixels += spans[i].opaque;
+            src_col += spans[i].opaque;
+
+            // Clip the translucent run and blend it.
+            start = (src_col > clip_area.x_start) ? src_col : clip_area.x_start;
+            end = src_col + spans[i].blend;
+            end = (end < clip_area.x_end) ? end : clip_area.x_end;
+            if (start < end)
+            {
+                if (dst->format == FMT_RGBA16)
+                {
+                    blend_pixels16((uint16_t*) dst->buffer + dst_index + start, pixels + (start - src_col), end - start, premultiplied);
+                }
+                else
+                {
+                    blend_pixels32((uint32_t*) dst->buffer + dst_index + start, pixels + (start - src_col), end - start, premultiplied);
+                }
+            }
+            pixels += spans[i].blend;
+            src_col += spans[i].blend;
+        }
+    }
+}
+
+/** @brief First character with a glyph in the font. */
+#define FONT_FIRST_CHAR     (' ')
+/** @brief Number of glyphs in the font, printable ASCII. */
+#define FONT_GLYPH_COUNT    (95)
+
+/**
+ * @brief Glyphs of printable ASCII prerendered to 1bpp masks, one byte per row.
+ *
+ * The most significant bit is the leftmost pixel. Glyphs are 5x7 pixels with a one pixel
+ * border on the left and a descender row at the bottom.
+ */
+static const uint8_t __font_glyphs[FONT_GLYPH_COUNT][FONT_HEIGHT] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // ' '
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x10, 0x00},   // '!'
+    {0x28, 0x28, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00},   // '"'
+    {0x28, 0x28, 0x7C, 0x28, 0x7C, 0x28, 0x28, 0x00},   // '#'
+    {0x10, 0x3C, 0x50, 0x38, 0x14, 0x78, 0x10, 0x00},   // '$'
+    {0x60, 0x64, 0x08, 0x10, 0x20, 0x4C, 0x0C, 0x00},   // '%'
+    {0x30, 0x48, 0x50, 0x20, 0x54, 0x48, 0x34, 0x00},   // '&'
+    {0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00},   // '''
+    {0x08, 0x10, 0x20, 0x20, 0x20, 0x10, 0x08, 0x00},   // '('
+    {0x20, 0x10, 0x08, 0x08, 0x08, 0x10, 0x20, 0x00},   // ')'
+    {0x00, 0x10, 0x54, 0x38, 0x54, 0x10, 0x00, 0x00},   // '*'
+    {0x00, 0x10, 0x10, 0x7C, 0x10, 0x10, 0x00, 0x00},   // '+'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x20},   // ','
+    {0x00, 0x00, 0x00, 0x7C, 0x00, 0x00, 0x00, 0x00},   // '-'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00},   // '.'
+    {0x00, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00, 0x00},   // '/'
+    {0x38, 0x44, 0x4C, 0x54, 0x64, 0x44, 0x38, 0x00},   // '0'
+    {0x10, 0x30, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00},   // '1'
+    {0x38, 0x44, 0x04, 0x08, 0x10, 0x20, 0x7C, 0x00},   // '2'
+    {0x7C, 0x08, 0x10, 0x08, 0x04, 0x44, 0x38, 0x00},   // '3'
+    {0x08, 0x18, 0x28, 0x48, 0x7C, 0x08, 0x08, 0x00},   // '4'
+    {0x7C, 0x40, 0x78, 0x04, 0x04, 0x44, 0x38, 0x00},   // '5'
+    {0x18, 0x20, 0x40, 0x78, 0x44, 0x44, 0x38, 0x00},   // '6'
+    {0x7C, 0x04, 0x08, 0x10, 0x20, 0x20, 0x20, 0x00},   // '7'
+    {0x38, 0x44, 0x44, 0x38, 0x44, 0x44, 0x38, 0x00},   // '8'
+    {0x38, 0x44, 0x44, 0x3C, 0x04, 0x08, 0x30, 0x00},   // '9'
+    {0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x00, 0x00},   // ':'
+    {0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x10, 0x20},   // ';'
+    {0x08, 0x10, 0x20, 0x40, 0x20, 0x10, 0x08, 0x00},   // '<'
+    {0x00, 0x00, 0x7C, 0x00, 0x7C, 0x00, 0x00, 0x00},   // '='
+    {0x20, 0x10, 0x08, 0x04, 0x08, 0x10, 0x20, 0x00},   // '>'
+    {0x38, 0x44, 0x04, 0x08, 0x10, 0x00, 0x10, 0x00},   // '?'
+    {0x38, 0x44, 0x04, 0x34, 0x54, 0x54, 0x38, 0x00},   // '@'
+    {0x38, 0x44, 0x44, 0x7C, 0x44, 0x44, 0x44, 0x00},   // 'A'
+    {0x78, 0x44, 0x44, 0x78, 0x44, 0x44, 0x78, 0x00},   // 'B'
+    {0x38, 0x44, 0x40, 0x40, 0x40, 0x44, 0x38, 0x00},   // 'C'
+    {0x70, 0x48, 0x44, 0x44, 0x44, 0x48, 0x70, 0x00},   // 'D'
+    {0x7C, 0x40, 0x40, 0x78, 0x40, 0x40, 0x7C, 0x00},   // 'E'
+    {0x7C, 0x40, 0x40, 0x78, 0x40, 0x40, 0x40, 0x00},   // 'F'
+    {0x38, 0x44, 0x40, 0x5C, 0x44, 0x44, 0x3C, 0x00},   // 'G'
+    {0x44, 0x44, 0x44, 0x7C, 0x44, 0x44, 0x44, 0x00},   // 'H'
+    {0x38, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00},   // 'I'
+    {0x1C, 0x08, 0x08, 0x08, 0x08, 0x48, 0x30, 0x00},   // 'J'
+    {0x44, 0x48, 0x50, 0x60, 0x50, 0x48, 0x44, 0x00},   // 'K'
+    {0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7C, 0x00},   // 'L'
+    {0x44, 0x6C, 0x54, 0x54, 0x44, 0x44, 0x44, 0x00},   // 'M'
+    {0x44, 0x44, 0x64, 0x54, 0x4C, 0x44, 0x44, 0x00},   // 'N'
+    {0x38, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00},   // 'O'
+    {0x78, 0x44, 0x44, 0x78, 0x40, 0x40, 0x40, 0x00},   // 'P'
+    {0x38, 0x44, 0x44, 0x44, 0x54, 0x48, 0x34, 0x00},   // 'Q'
+    {0x78, 0x44, 0x44, 0x78, 0x50, 0x48, 0x44, 0x00},   // 'R'
+    {0x3C, 0x40, 0x40, 0x38, 0x04, 0x04, 0x78, 0x00},   // 'S'
+    {0x7C, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00},   // 'T'
+    {0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00},   // 'U'
+    {0x44, 0x44, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00},   // 'V'
+    {0x44, 0x44, 0x44, 0x54, 0x54, 0x54, 0x28, 0x00},   // 'W'
+    {0x44, 0x44, 0x28, 0x10, 0x28, 0x44, 0x44, 0x00},   // 'X'
+    {0x44, 0x44, 0x28, 0x10, 0x10, 0x10, 0x10, 0x00},   // 'Y'
+    {0x7C, 0x04, 0x08, 0x10, 0x20, 0x40, 0x7C, 0x00},   // 'Z'
+    {0x38, 0x20, 0x20, 0x20, 0x20, 0x20, 0x38, 0x00},   // '['
+    {0x00, 0x40, 0x20, 0x10, 0x08, 0x04, 0x00, 0x00},   // '\\'
+    {0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00},   // ']'
+    {0x10, 0x28, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00},   // '^'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C},   // '_'
+    {0x20, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // '`'
+    {0x00, 0x00, 0x38, 0x04, 0x3C, 0x44, 0x3C, 0x00},   // 'a'
+    {0x40, 0x40, 0x78, 0x44, 0x44, 0x44, 0x78, 0x00},   // 'b'
+    {0x00, 0x00, 0x38, 0x40, 0x40, 0x44, 0x38, 0x00},   // 'c'
+    {0x04, 0x04, 0x3C, 0x44, 0x44, 0x44, 0x3C, 0x00},   // 'd'
+    {0x00, 0x00, 0x38, 0x44, 0x7C, 0x40, 0x38, 0x00},   // 'e'
+    {0x18, 0x24, 0x20, 0x70, 0x20, 0x20, 0x20, 0x00},   // 'f'
+    {0x00, 0x00, 0x3C, 0x44, 0x44, 0x3C, 0x04, 0x38},   // 'g'
+    {0x40, 0x40, 0x58, 0x64, 0x44, 0x44, 0x44, 0x00},   // 'h'
+    {0x10, 0x00, 0x30, 0x10, 0x10, 0x10, 0x38, 0x00},   // 'i'
+    {0x08, 0x00, 0x18, 0x08, 0x08, 0x08, 0x48, 0x30},   // 'j'
+    {0x40, 0x40, 0x48, 0x50, 0x60, 0x50, 0x48, 0x00},   // 'k'
+    {0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00},   // 'l'
+    {0x00, 0x00, 0x68, 0x54, 0x54, 0x44, 0x44, 0x00},   // 'm'
+    {0x00, 0x00, 0x58, 0x64, 0x44, 0x44, 0x44, 0x00},   // 'n'
+    {0x00, 0x00, 0x38, 0x44, 0x44, 0x44, 0x38, 0x00},   // 'o'
+    {0x00, 0x00, 0x78, 0x44, 0x44, 0x78, 0x40, 0x40},   // 'p'
+    {0x00, 0x00, 0x3C, 0x44, 0x44, 0x3C, 0x04, 0x04},   // 'q'
+    {0x00, 0x00, 0x58, 0x64, 0x40, 0x40, 0x40, 0x00},   // 'r'
+    {0x00, 0x00, 0x3C, 0x40, 0x38, 0x04, 0x78, 0x00},   // 's'
+    {0x20, 0x20, 0x70, 0x20, 0x20, 0x24, 0x18, 0x00},   // 't'
+    {0x00, 0x00, 0x44, 0x44, 0x44, 0x4C, 0x34, 0x00},   // 'u'
+    {0x00, 0x00, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00},   // 'v'
+    {0x00, 0x00, 0x44, 0x44, 0x54, 0x54, 0x28, 0x00},   // 'w'
+    {0x00, 0x00, 0x44, 0x28, 0x10, 0x28, 0x44, 0x00},   // 'x'
+    {0x00, 0x00, 0x44, 0x44, 0x44, 0x3C, 0x04, 0x38},   // 'y'
+    {0x00, 0x00, 0x7C, 0x08, 0x10, 0x20, 0x7C, 0x00},   // 'z'
+    {0x08, 0x10, 0x10, 0x20, 0x10, 0x10, 0x08, 0x00},   // '{'
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00},   // '|'
+    {0x20, 0x10, 0x10, 0x08, 0x10, 0x10, 0x20, 0x00},   // '}'
+    {0x00, 0x00, 0x20, 0x54, 0x08, 0x00, 0x00, 0x00},   // '~'
+};
+
+/** @brief Write the pixels selected by one glyph mask byte into a 16-bit surface. */
+static inline void expand_mask16(uint16_t* dst, uint8_t mask, uint16_t color)
+{
+    // Stops as soon as the remaining pixels are all clear.
+    for (; mask; mask <<= 1, dst++)
+    {
+        if (mask & 0x80)
+        {
+            *dst = color;
+        }
+    }
+}
+
+/** @brief Write the pixels selected by one glyph mask byte into a 32-bit surface. */
+static inline void expand_mask32(uint32_t* dst, uint8_t mask, uint32_t color)
+{
+    for (; mask; mask <<= 1, dst++)
+    {
+        if (mask & 0x80)
+        {
+            *dst = color;
+        }
+    }
+}
+
+/** @brief Blend the pixels selected by one glyph mask byte. */
+static inline void expand_mask_alpha(surface_t* dst, int index, uint8_t mask, uint32_t color)
+{
+    for (; mask; mask <<= 1, index++)
+    {
+        if (mask & 0x80)
+        {
+            draw_pixel(dst, index, alphablend_pixel(get_pixel(dst, index), color));
+        }
+    }
+}
+
+/** @brief Draw one glyph, clipping by masking off columns and skipping rows. */
+static void draw_glyph(surface_t* dst, int x, int y, const uint8_t* glyph, uint32_t color, uint16_t color16)
+{
+    // Columns left or right of the surface are masked off, so no pixel is bounds checked.
+    int shift = 0;
+    uint8_t clip_mask = 0xFF;
+    if (x < 0)
+    {
+        shift = -x;
+        x = 0;
+    }
+    if (x + FONT_WIDTH - shift > dst->width)
+    {
+        clip_mask <<= x + FONT_WIDTH - shift - dst->width;
+    }
+
+    int row0 = (y < 0) ? -y : 0;
+    int row1 = (y + FONT_HEIGHT > dst->height) ? (dst->height - y) : FONT_HEIGHT;
+    bool alpha = (color & 0xFF) != 0xFF;
+
+    for (int row = row0; row < row1; row++)
+    {
+        uint8_t mask = (uint8_t) (glyph[row] << shift) & clip_mask;
+        int index = x + ((y + row) * dst->width);
+
+        if (alpha)
+        {
+            expand_mask_alpha(dst, index, mask, color);
+        }
+        else if (dst->format == FMT_RGBA16)
+        {
+            expand_mask16((uint16_t*) dst->buffer + index, mask, color16);
+        }
+        else
+        {
+            expand_mask32((uint32_t*) dst->buffer + index, mask, color);
+        }
+    }
+}
+
+void graphics_draw_text(surface_t* dst, int x, int y, const char* text, uint32_t color)
+{
+    // Sanity checking
+    if (dst->buffer == NULL)
+    {
+        return;
+    }
+    if ((text == NULL) || ((color & 0xFF) == 0))
+    {
+        return;
+    }
+
+    // Make sure we touch text in kernel segment.
+    text = (const char*) ADDR_TO_KSEG0((uintptr_t) text);
+
+    // Don't race with the RDP.
+    rdp_wait_surface(dst);
+
+    uint16_t color16 = color_to_rgba16(color);
+    int line_start = 0;
+
+    for (int i = 0; ; i++)
+    {
+        char c = text[i];
+        if ((c == '\n') || (c == '\0'))
+        {
+            // Mark the finished line dirty in one go.
+            int x0 = x;
+            int y0 = y;
+            int x1 = x + ((i - line_start) * FONT_WIDTH);
+            int y1 = y + FONT_HEIGHT;
+            x0 = (x0 > 0) ? x0 : 0;
+            y0 = (y0 > 0) ? y0 : 0;
+            x1 = (x1 < dst->width) ? x1 : dst->width;
+            y1 = (y1 < dst->height) ? y1 : dst->height;
+            if ((x0 < x1) && (y0 < y1))
+            {
+                display_mark_dirty(dst, x0, y0, x1, y1);
+                for (int j = line_start; j < i; j++)
+                {
+                    int glyph_x = x + ((j - line_start) * FONT_WIDTH);
+                    if ((glyph_x + FONT_WIDTH <= 0) || (glyph_x >= dst->width))
+                    {
+                        continue;
+                    }
+
+                    int glyph = (uint8_t) text[j] - FONT_FIRST_CHAR;
+                    if ((glyph < 0) || (glyph >= FONT_GLYPH_COUNT))
+                    {
+                        glyph = '?' - FONT_FIRST_CHAR;
+                    }
+                    draw_glyph(dst, glyph_x, y, __font_glyphs[glyph], color, color16);
+                }
+            }
+
+            if (c == '\0')
             {
-                uint32_t dst_color = get_pixel(dst->buffer, index);
-                uint32_t new_color = alphablend_pixel(dst_color, src_color);
-                draw_pixel(dst->buffer, index, new_color);
+                break;
             }
+            y += FONT_HEIGHT;
+            line_start = i + 1;
+        }
+    }
+}
+
+void graphics_submit(const graphics_cmd_t* cmds, int count)
+{
+    // Make sure we touch command data in kernel segment.
+    cmds = (const graphics_cmd_t*) ADDR_TO_KSEG0((uintptr_t) cmds);
+
+    for (int i = 0; i < count; i++)
+    {
+        const graphics_cmd_t* cmd = &cmds[i];
+        surface_t* dst = (surface_t*) ADDR_TO_KSEG0((uintptr_t) cmd->dst);
+        bool alpha = cmd->flags & GRAPHICS_CMD_FLAGS_ALPHA;
+
+        switch (cmd->type)
+        {
+            case GRAPHICS_CMD_FILL:
+                graphics_fill(dst, cmd->color);
+                break;
+            case GRAPHICS_CMD_RESTORE_BACKGROUND:
+                graphics_restore_background(dst, cmd->color);
+                break;
+            case GRAPHICS_CMD_FILL_RECT:
+                if (alpha)
+                {
+                    graphics_fill_rect_alpha(dst, cmd->x, cmd->y, cmd->width, cmd->height, cmd->color);
+                }
+                else
+                {
+                    graphics_fill_rect(dst, cmd->x, cmd->y, cmd->width, cmd->height, cmd->color);
+                }
+                break;
+            case GRAPHICS_CMD_DRAW_SURFACE:
+                graphics_draw_surface(dst, cmd->x, cmd->y, (surface_t*) ADDR_TO_KSEG0((uintptr_t) cmd->src));
+                break;
+            case GRAPHICS_CMD_DRAW_SURFACE_ALPHA:
+                graphics_draw_surface_alpha(dst, cmd->x, cmd->y, (surface_t*) ADDR_TO_KSEG0((uintptr_t) cmd->src));
+                break;
+            case GRAPHICS_CMD_DRAW_SPRITE_RLE:
+                graphics_draw_sprite_rle(dst, cmd->x, cmd->y, cmd->sprite);
+                break;
+            case GRAPHICS_CMD_DRAW_LINE:
+                if (alpha)
+                {
+                    graphics_draw_line_alpha(dst, cmd->x, cmd->y, cmd->x1, cmd->y1, cmd->color);
+                }
+                else
+                {
+                    graphics_draw_line(dst, cmd->x, cmd->y, cmd->x1, cmd->y1, cmd->color);
+                }
+                break;
+            case GRAPHICS_CMD_DRAW_RECT:
+                if (alpha)
+                {
+                    graphics_draw_rect_alpha(dst, cmd->x, cmd->y, cmd->width, cmd->height, cmd->color);
+                }
+                else
+                {
+                    graphics_draw_rect(dst, cmd->x, cmd->y, cmd->width, cmd->height, cmd->color);
+                }
+                break;
+            case GRAPHICS_CMD_DRAW_CIRCLE:
+                if (alpha)
+                {
+                    graphics_draw_circle_alpha(dst, cmd->x, cmd->y, cmd->radius, cmd->color);
+                }
+                else
+                {
+                    graphics_draw_circle(dst, cmd->x, cmd->y, cmd->radius, cmd->color);
+                }
+                break;
+            case GRAPHICS_CMD_FILL_CIRCLE:
+                if (alpha)
+                {
+                    graphics_fill_circle_alpha(dst, cmd->x, cmd->y, cmd->radius, cmd->color);
+                }
+                else
+                {
+                    graphics_fill_circle(dst, cmd->x, cmd->y, cmd->radius, cmd->color);
+                }
+                break;
+            default:
+                assert(false, "graphics_submit: Unknown command type.");
+                break;
         }
     }
 }
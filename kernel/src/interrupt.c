@@ -3,12 +3,18 @@
 #include "ai.h"
 #include "mi.h"
 #include "si.h"
+#include "sp.h"
 #include "vi.h"
 #include "system.h"
 #include "interrupt.h"
 #include "audio.h"
 #include "controller.h"
 #include "graphics.h"
+#include "tilemap.h"
+#include "sprite.h"
+#include "primitives.h"
+#include "pool.h"
+#include "arena.h"
 
 /** @brief Number of nested disable interrupt calls
  *
@@ -112,6 +118,16 @@ void interrupt_set_VI(bool active, uint32_t line)
     }
 }
 
+void interrupt_set_DP(bool active)
+{
+    MI_regs->mask = (active) ? MI_MASK_SET_DP : MI_MASK_CLR_DP;
+}
+
+void interrupt_set_SP(bool active)
+{
+    MI_regs->mask = (active) ? MI_MASK_SET_SP : MI_MASK_CLR_SP;
+}
+
 void interrupt_reset_mode(void)
 {
     // Disable FPU, reset to kernel mode, disable exception flag and disable global exceptions.
@@ -129,6 +145,10 @@ void __display_callback(void);
 void __joypad_callback(void);
 // Updates internal controller state when SI DMA finishes.
 void __controller_callback(void);
+// Marks the RDP as idle after SYNC_FULL.
+void __rdp_callback(void);
+// Finishes the current RSP task and starts the next one.
+void __rsp_callback(void);
 
 void interrupt_handler(void)
 {
@@ -154,6 +174,18 @@ void interrupt_handler(void)
         __display_callback();
         __joypad_callback();
     }
+    if (status & MI_INTERRUPT_SP)
+    {
+        // Clear interrupt.
+        SP_regs->status = SP_STATUS_CLR_INTR;
+        __rsp_callback();
+    }
+    if (status & MI_INTERRUPT_DP)
+    {
+        // Clear interrupt.
+        MI_regs->mode = MI_MODE_CLR_DPINT;
+        __rdp_callback();
+    }
 }
 
 void exception_reset_mode(void)
@@ -232,23 +264,149 @@ void exception_handler(void)
             surface_t* src = (surface_t*) GET_SYSCALL_ARG4();
             graphics_draw_surface_alpha(dst, x, y, src);
         }
+        else if (syscode == SYSCALL_GRAPHICS_DRAW_SPRITE_RLE)
+        {
+            surface_t* dst = (surface_t*) GET_SYSCALL_ARG1();
+            int x = GET_SYSCALL_ARG2();
+            int y = GET_SYSCALL_ARG3();
+            const sprite_rle_t* sprite = (const sprite_rle_t*) GET_SYSCALL_ARG4();
+            graphics_draw_sprite_rle(dst, x, y, sprite);
+        }
+        else if (syscode == SYSCALL_GRAPHICS_RESTORE_BACKGROUND)
+        {
+            surface_t* surface = (surface_t*) GET_SYSCALL_ARG1();
+            uint32_t color = GET_SYSCALL_ARG2();
+            graphics_restore_background(surface, color);
+        }
+        else if (syscode == SYSCALL_GRAPHICS_SUBMIT)
+        {
+            const graphics_cmd_t* cmds = (const graphics_cmd_t*) GET_SYSCALL_ARG1();
+            int count = GET_SYSCALL_ARG2();
+            graphics_submit(cmds, count);
+        }
+        else if (syscode == SYSCALL_TILEMAP_DRAW)
+        {
+            surface_t* dst = (surface_t*) GET_SYSCALL_ARG1();
+            const tilemap_t* map = (const tilemap_t*) GET_SYSCALL_ARG2();
+            tilemap_draw(dst, map);
+        }
+        else if (syscode == SYSCALL_SPRITE_BATCH_DRAW)
+        {
+            surface_t* dst = (surface_t*) GET_SYSCALL_ARG1();
+            const sprite_draw_t* draws = (const sprite_draw_t*) GET_SYSCALL_ARG2();
+            int count = GET_SYSCALL_ARG3();
+            sprite_batch_draw(dst, draws, count);
+        }
+        else if (syscode == SYSCALL_GRAPHICS_DRAW_LINE)
+        {
+            // Shapes are blended when their color isn't opaque.
+            surface_t* dst = (surface_t*) GET_SYSCALL_ARG1();
+            uint32_t p0 = GET_SYSCALL_ARG2();
+            uint32_t p1 = GET_SYSCALL_ARG3();
+            uint32_t color = GET_SYSCALL_ARG4();
+            graphics_draw_line_alpha(dst, GRAPHICS_UNPACK_X(p0), GRAPHICS_UNPACK_Y(p0), GRAPHICS_UNPACK_X(p1), GRAPHICS_UNPACK_Y(p1), color);
+        }
+        else if ((syscode == SYSCALL_GRAPHICS_DRAW_RECT) || (syscode == SYSCALL_GRAPHICS_FILL_RECT))
+        {
+            surface_t* dst = (surface_t*) GET_SYSCALL_ARG1();
+            uint32_t position = GET_SYSCALL_ARG2();
+            uint32_t size = GET_SYSCALL_ARG3();
+            uint32_t color = GET_SYSCALL_ARG4();
+            if (syscode == SYSCALL_GRAPHICS_DRAW_RECT)
+            {
+                graphics_draw_rect_alpha(dst, GRAPHICS_UNPACK_X(position), GRAPHICS_UNPACK_Y(position), GRAPHICS_UNPACK_X(size), GRAPHICS_UNPACK_Y(size), color);
+            }
+            else
+            {
+                graphics_fill_rect_alpha(dst, GRAPHICS_UNPACK_X(position), GRAPHICS_UNPACK_Y(position), GRAPHICS_UNPACK_X(size), GRAPHICS_UNPACK_Y(size), color);
+            }
+        }
+        else if ((syscode == SYSCALL_GRAPHICS_DRAW_CIRCLE) || (syscode == SYSCALL_GRAPHICS_FILL_CIRCLE))
+        {
+            surface_t* dst = (surface_t*) GET_SYSCALL_ARG1();
+            uint32_t center = GET_SYSCALL_ARG2();
+            int radius = GET_SYSCALL_ARG3();
+            uint32_t color = GET_SYSCALL_ARG4();
+            if (syscode == SYSCALL_GRAPHICS_DRAW_CIRCLE)
+            {
+                graphics_draw_circle_alpha(dst, GRAPHICS_UNPACK_X(center), GRAPHICS_UNPACK_Y(center), radius, color);
+            }
+            else
+            {
+                graphics_fill_circle_alpha(dst, GRAPHICS_UNPACK_X(center), GRAPHICS_UNPACK_Y(center), radius, color);
+            }
+        }
+        else if (syscode == SYSCALL_GRAPHICS_DRAW_SURFACE_TRANSFORMED)
+        {
+            surface_t* dst = (surface_t*) GET_SYSCALL_ARG1();
+            uint32_t position = GET_SYSCALL_ARG2();
+            surface_t* src = (surface_t*) GET_SYSCALL_ARG3();
+            const blit_params_t* params = (const blit_params_t*) GET_SYSCALL_ARG4();
+            graphics_draw_surface_transformed(dst, GRAPHICS_UNPACK_X(position), GRAPHICS_UNPACK_Y(position), src, params);
+        }
+        else if (syscode == SYSCALL_GRAPHICS_DRAW_TEXT)
+        {
+            surface_t* dst = (surface_t*) GET_SYSCALL_ARG1();
+            uint32_t position = GET_SYSCALL_ARG2();
+            const char* text = (const char*) GET_SYSCALL_ARG3();
+            uint32_t color = GET_SYSCALL_ARG4();
+            graphics_draw_text(dst, GRAPHICS_UNPACK_X(position), GRAPHICS_UNPACK_Y(position), text, color);
+        }
         else if (syscode == SYSCALL_DISPLAY_INIT)
         {
             int width = GET_SYSCALL_ARG1();
             int height = GET_SYSCALL_ARG2();
-            filter_t filter = GET_SYSCALL_ARG3();
-            display_init(width, height, filter);
+            // Format, buffer count and present mode are packed into one argument.
+            uint32_t config = GET_SYSCALL_ARG3();
+            surface_format_t format = config & 0xFF;
+            int num_buffers = (config >> 8) & 0xFF;
+            present_mode_t present_mode = (config >> 16) & 0xFF;
+            filter_t filter = GET_SYSCALL_ARG4();
+            display_init(width, height, format, num_buffers, present_mode, filter);
+        }
+        else if (syscode == SYSCALL_DISPLAY_SET_CACHED)
+        {
+            bool cached = GET_SYSCALL_ARG1();
+            display_set_cached(cached);
         }
         else if (syscode == SYSCALL_DISPLAY_GET)
         {
             uint32_t retval = (uint32_t) display_get();
             SET_SYSCALL_RETVAL(retval);
         }
+        else if (syscode == SYSCALL_DISPLAY_TRY_GET)
+        {
+            uint32_t retval = (uint32_t) display_try_get();
+            SET_SYSCALL_RETVAL(retval);
+        }
         else if (syscode == SYSCALL_DISPLAY_SHOW)
         {
             surface_t* display = (surface_t*) GET_SYSCALL_ARG1();
             display_show(display);
         }
+        else if (syscode == SYSCALL_DISPLAY_GET_STATS)
+        {
+            display_stats_t* stats = (display_stats_t*) GET_SYSCALL_ARG1();
+            display_get_stats(stats);
+        }
+        else if (syscode == SYSCALL_DISPLAY_SET_STATS_DUMP)
+        {
+            int interval = GET_SYSCALL_ARG1();
+            display_set_stats_dump(interval);
+        }
+        else if (syscode == SYSCALL_POOL_CREATE)
+        {
+            uint32_t obj_size = GET_SYSCALL_ARG1();
+            uint32_t count = GET_SYSCALL_ARG2();
+            uint32_t flags = GET_SYSCALL_ARG3();
+            uint32_t retval = (uint32_t) pool_create_useg(obj_size, count, flags);
+            SET_SYSCALL_RETVAL(retval);
+        }
+        else if (syscode == SYSCALL_FRAME_ARENA_GET)
+        {
+            uint32_t retval = (uint32_t) frame_arena_get();
+            SET_SYSCALL_RETVAL(retval);
+        }
         else
         {
             println_u32("Unknown syscode: ", syscode);
@@ -0,0 +1,169 @@
+/**
+ * @file lz4.c
+ * @brief This module decompresses LZ4 compressed blobs, see lz4_blob_t.
+ *
+ * The decompressor is tuned for the VR4300: literals and non-overlapping matches
+ * are copied a 32-bit word at a time through unaligned accesses, which the CPU
+ * handles with a pair of lwl/lwr and swl/swr instructions. Matches that overlap
+ * themselves (runs of a repeated byte pattern) are seeded byte by byte and then
+ * continue with word copies as well.
+ */
+
+#include "lz4.h"
+#include "system.h"
+#include "cop0.h"
+
+/** @brief COP0 Count increments per second, half of the 93.75 MHz CPU clock. */
+#define LZ4_COUNTS_PER_SECOND   (46875000.0f)
+
+/** @brief Unaligned 32-bit word. GCC accesses it with lwl/lwr and swl/swr. */
+typedef struct lz4_word_s
+{
+    uint32_t value;
+} __attribute__((packed)) lz4_word_t;
+
+/** @brief Copy bytes forward a word at a time. Source may overlap if it's at least 4 bytes behind. */
+static inline void lz4_copy_words(uint8_t* dst, const uint8_t* src, uint32_t len)
+{
+    while (len >= 4)
+    {
+        ((lz4_word_t*) dst)->value = ((const lz4_word_t*) src)->value;
+        dst += 4;
+        src += 4;
+        len -= 4;
+    }
+    while (len--)
+    {
+        *dst++ = *src++;
+    }
+}
+
+/**
+ * @brief Read the extension bytes of a 15 length nibble.
+ *
+ * @return Extended length, or 0 if the input ended.
+ */
+static inline uint32_t lz4_read_length(const uint8_t** in, const uint8_t* in_end, uint32_t length)
+{
+    uint32_t byte;
+    do
+    {
+        if (*in >= in_end)
+        {
+            return 0;
+        }
+        byte = *(*in)++;
+        length += byte;
+    } while (byte == 255);
+
+    return length;
+}
+
+uint32_t lz4_decompressed_size(const void* blob)
+{
+    const lz4_blob_t* header = blob;
+    return (header->magic == LZ4_MAGIC) ? header->size : 0;
+}
+
+int lz4_decompress(void* dst, uint32_t dst_size, const void* blob, uint32_t blob_size)
+{
+    const lz4_blob_t* header = blob;
+    if ((blob_size < sizeof(lz4_blob_t)) || (header->magic != LZ4_MAGIC) || (header->size > dst_size))
+    {
+        return -1;
+    }
+
+    const uint8_t* in = header->data;
+    const uint8_t* in_end = (const uint8_t*) blob + blob_size;
+    uint8_t* out = dst;
+    uint8_t* out_end = out + header->size;
+
+    while (in < in_end)
+    {
+        uint32_t token = *in++;
+
+        // Literals.
+        uint32_t length = token >> 4;
+        if (length == 15)
+        {
+            length = lz4_read_length(&in, in_end, length);
+        }
+        if ((length > (uint32_t) (in_end - in)) || (length > (uint32_t) (out_end - out)))
+        {
+            return -1;
+        }
+        lz4_copy_words(out, in, length);
+        in += length;
+        out += length;
+
+        // The last sequence has no match. The blob may be padded after it.
+        if (out == out_end)
+        {
+            break;
+        }
+
+        // Match.
+        if (in_end - in < 2)
+        {
+            return -1;
+        }
+        uint32_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        if ((offset == 0) || (offset > (uint32_t) (out - (uint8_t*) dst)))
+        {
+            return -1;
+        }
+
+        length = (token & 0xF) + 4;
+        if (length == 15 + 4)
+        {
+            length = lz4_read_length(&in, in_end, length);
+        }
+        if ((length == 0) || (length > (uint32_t) (out_end - out)))
+        {
+            return -1;
+        }
+
+        if (offset < 4)
+        {
+            // The match repeats a pattern shorter than a word. Write enough of it byte
+            // by byte that the rest can be copied from a whole number of periods back.
+            uint32_t distance = (offset == 3) ? 6 : 4;
+            uint32_t seed = (length < distance) ? length : distance;
+            const uint8_t* match = out - offset;
+            for (uint32_t i = 0; i < seed; i++)
+            {
+                out[i] = match[i];
+            }
+            lz4_copy_words(out + seed, out + seed - distance, length - seed);
+        }
+        else
+        {
+            lz4_copy_words(out, out - offset, length);
+        }
+        out += length;
+    }
+
+    return (out == out_end) ? (int) header->size : -1;
+}
+
+float lz4_benchmark(void* dst, const void* blob, uint32_t blob_size, int iterations)
+{
+    uint32_t size = lz4_decompressed_size(blob);
+
+    uint32_t start = C0_COUNT();
+    for (int i = 0; i < iterations; i++)
+    {
+        lz4_decompress(dst, size, blob, blob_size);
+    }
+    uint32_t cycles = C0_COUNT() - start;
+
+    float seconds = (float) cycles / LZ4_COUNTS_PER_SECOND;
+    float mb_per_second = ((float) size * (float) iterations) / (seconds * 1000000.0f);
+
+    println_u32("lz4: compressed bytes: ", blob_size);
+    println_u32("lz4: decompressed bytes: ", size);
+    println_u32("lz4: throughput (KB/s): ", (uint32_t) (mb_per_second * 1000.0f));
+
+    return mb_per_second;
+}
@@ -33,7 +33,8 @@ game_obj_t player = (game_obj_t) {
     .sprite = (surface_t) {
         .width = 16,
         .height = 32,
-        .buffer = (uint32_t*) sprite_astroman_data
+        .buffer = (uint32_t*) sprite_astroman_data,
+        .format = FMT_RGBA32
     }
 };
 
@@ -44,7 +45,8 @@ game_obj_t letter_k = (game_obj_t) {
     .sprite = (surface_t) {
         .width = 32,
         .height = 32,
-        .buffer = (uint32_t*) sprite_k_data
+        .buffer = (uint32_t*) sprite_k_data,
+        .format = FMT_RGBA32
     }
 };
 
@@ -55,7 +57,8 @@ game_obj_t letter_i = (game_obj_t) {
     .sprite = (surface_t) {
         .width = 16,
         .height = 32,
-        .buffer = (uint32_t*) sprite_i_data
+        .buffer = (uint32_t*) sprite_i_data,
+        .format = FMT_RGBA32
     }
 };
 
@@ -66,7 +69,8 @@ game_obj_t letter_v = (game_obj_t) {
     .sprite = (surface_t) {
         .width = 32,
         .height = 32,
-        .buffer = (uint32_t*) sprite_v_data
+        .buffer = (uint32_t*) sprite_v_data,
+        .format = FMT_RGBA32
     }
 };
 
@@ -123,7 +127,7 @@ void game_obj_draw(surface_t* display, game_obj_t* game_obj)
         return;
     }
 
-    graphics_draw_surface_alpha_user(display, game_obj->x, game_obj->y, &game_obj->sprite);
+    graphics_batch_draw_surface_alpha_user(display, game_obj->x, game_obj->y, &game_obj->sprite);
 }
 
 void game_obj_spawn(game_obj_t* game_obj)
@@ -156,7 +160,9 @@ void game_obj_spawn(game_obj_t* game_obj)
 
 void main(void)
 {
-    display_init_user(RES_WIDTH, RES_HEIGHT, FILTER_NONE);
+    display_init_user(RES_WIDTH, RES_HEIGHT, FMT_RGBA16, 3, PRESENT_VSYNC, FILTER_NONE);
+    // Blending reads the framebuffer, so go through the cache.
+    display_set_cached_user(true);
 
     uint32_t bg_fill = RGBA32(0, 0, 0, 255);
 
@@ -227,11 +233,14 @@ void main(void)
         }
         
         surface_t* display = display_get_user();
-        graphics_fill_user(display, bg_fill);
+        // Only the parts covered by sprites last time this buffer was used need clearing.
+        graphics_batch_restore_background_user(display, bg_fill);
         for (int i = 0; i < GAME_OBJ_COUNT; i++)
         {
             game_obj_draw(display, game_objs[i]);
         }
+        // Draw the whole frame with a single syscall.
+        graphics_submit_user();
         display_show_user(display);
 
         frame_counter++;
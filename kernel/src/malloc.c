@@ -1,95 +1,525 @@
 #include "intdef.h"
 #include "system.h"
+#include "memory.h"
 
 #define ONE_MB                  (1024 * 1024)
 #define RAM_SIZE                (__boot_memsize)
 #define KERNEL_HEAP_START       (ADDR_TO_KSEG0(1 * ONE_MB))
 #define KERNEL_HEAP_END         (ADDR_TO_KSEG0(RAM_SIZE - ONE_MB))
 
+#ifndef KIVOS_HOST
 _Static_assert(KERNEL_HEAP_START == 0x80100000, "KERNEL_HEAP_START != 0x80100000");
+#endif
 
-typedef struct block_info_s
+/** @brief Alignment of every block and allocation, one data cache line. */
+#define HEAP_ALIGN              (16)
+/** @brief Low bit of block_info_t::size, set while the block is allocated. */
+#define BLOCK_USED              (1)
+
+/**
+ * @brief Header in front of every heap block.
+ *
+ * Blocks tile the heap without gaps. Besides its own size, every header carries
+ * the size of the block right before it (its boundary tag), so a freed block can
+ * find and merge with both of its neighbours without walking the heap.
+ */
+typedef struct __attribute__((aligned(HEAP_ALIGN))) block_info_s
 {
-    struct block_info_s* prev;
-    struct block_info_s* next;
-    bool is_free;
-    int size;
+    uint32_t size;                      // Size including the header, BLOCK_USED in the low bit.
+    uint32_t prev_size;                 // Size of the previous block in memory, 0 for the first one.
+    struct block_info_s* prev_free;     // Free list links, only valid while the block is free.
+    struct block_info_s* next_free;
 } block_info_t;
 
-block_info_t* mem_block_list_head;
+_Static_assert(sizeof(block_info_t) % HEAP_ALIGN == 0, "block_info_t breaks heap alignment");
 
-void malloc_init(void)
+/** @brief Smallest block worth splitting off, a header and one cache line. */
+#define BLOCK_MIN_SIZE          (sizeof(block_info_t) + HEAP_ALIGN)
+
+/**
+ * Free blocks are kept in size classes, Two-Level Segregated Fit style. The first
+ * level splits sizes by powers of two, the second splits each power of two into
+ * TLSF_SL_COUNT equal parts. Blocks below TLSF_SMALL_SIZE all go to the first row,
+ * one class per HEAP_ALIGN bytes. A bitmap per level marks the non-empty classes, so
+ * malloc and free find a class with a couple of bit scans instead of walking blocks.
+ */
+/** @brief Log2 of the number of second level classes. */
+#define TLSF_SL_LOG2            (4)
+#define TLSF_SL_COUNT           (1 << TLSF_SL_LOG2)
+/** @brief Sizes below this are all in the first row, 16 bytes per class. */
+#define TLSF_SMALL_SIZE         (TLSF_SL_COUNT * HEAP_ALIGN)
+/** @brief First level of the smallest power of two above the small sizes. */
+#define TLSF_FL_SHIFT           (TLSF_SL_LOG2 + 4)
+/** @brief Number of first level classes, enough for blocks below 8 MB. */
+#define TLSF_FL_COUNT           (23 - TLSF_FL_SHIFT + 1)
+
+_Static_assert(TLSF_SMALL_SIZE == (1 << TLSF_FL_SHIFT), "TLSF small sizes must end at a power of two");
+
+/** @brief First block of the heap. */
+static block_info_t* __heap_start;
+/** @brief End of the heap, the last block ends right here. */
+static block_info_t* __heap_end;
+/** @brief Bitmap of first level classes that have any free blocks. */
+static uint32_t __fl_bitmap;
+/** @brief Bitmaps of second level classes that have free blocks, per first level. */
+static uint32_t __sl_bitmap[TLSF_FL_COUNT];
+/** @brief Free blocks of each size class, in no particular order. */
+static block_info_t* __free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+/**
+ * @brief Get the index of the highest set bit, which must exist.
+ *
+ * The VR4300 has no count leading zeros instruction and there's no libgcc to provide
+ * one, so this is a fixed five step binary search.
+ */
+static inline int bit_fls(uint32_t value)
 {
-    mem_block_list_head = (block_info_t*) KERNEL_HEAP_START;
-    mem_block_list_head->prev = NULL;
-    mem_block_list_head->next = NULL;
-    mem_block_list_head->is_free = true;
-    mem_block_list_head->size = KERNEL_HEAP_END - KERNEL_HEAP_START - sizeof(block_info_t);
+    int bit = 0;
+    if (value & 0xFFFF0000)
+    {
+        bit += 16;
+        value >>= 16;
+    }
+    if (value & 0xFF00)
+    {
+        bit += 8;
+        value >>= 8;
+    }
+    if (value & 0xF0)
+    {
+        bit += 4;
+        value >>= 4;
+    }
+    if (value & 0xC)
+    {
+        bit += 2;
+        value >>= 2;
+    }
+    if (value & 0x2)
+    {
+        bit += 1;
+    }
+
+    return bit;
 }
 
-void free(void* first_byte)
+/** @brief Get the index of the lowest set bit, which must exist. */
+static inline int bit_ffs(uint32_t value)
+{
+    return bit_fls(value & -value);
+}
+
+/** @brief Get the size class a free block of a given size belongs to. */
+static inline void tlsf_mapping(uint32_t size, int* fl, int* sl)
 {
-    
+    if (size < TLSF_SMALL_SIZE)
+    {
+        *fl = 0;
+        *sl = size / HEAP_ALIGN;
+    }
+    else
+    {
+        int bit = bit_fls(size);
+        *fl = bit - TLSF_FL_SHIFT + 1;
+        *sl = (size >> (bit - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+    }
+}
+
+/** @brief Get the size of a block, whether it's used or not. */
+static inline uint32_t block_size(block_info_t* block)
+{
+    return block->size & ~BLOCK_USED;
+}
+
+/** @brief Get the block following a block in memory, #__heap_end for the last one. */
+static inline block_info_t* block_next(block_info_t* block)
+{
+    return (block_info_t*) ((uint8_t*) block + block_size(block));
+}
+
+/** @brief Set the size of a block and the boundary tag in the block after it. */
+static void block_set_size(block_info_t* block, uint32_t size, uint32_t used)
+{
+    block->size = size | used;
+
+    block_info_t* next = block_next(block);
+    if (next < __heap_end)
+    {
+        next->prev_size = size;
+    }
+}
+
+static void free_list_insert(block_info_t* block)
+{
+    int fl;
+    int sl;
+    tlsf_mapping(block->size, &fl, &sl);
+
+    block_info_t* head = __free_lists[fl][sl];
+    block->prev_free = NULL;
+    block->next_free = head;
+    if (head != NULL)
+    {
+        head->prev_free = block;
+    }
+    __free_lists[fl][sl] = block;
+
+    __fl_bitmap |= 1 << fl;
+    __sl_bitmap[fl] |= 1 << sl;
 }
 
-static block_info_t* find_free_block(size_t numbytes)
+static void free_list_remove(block_info_t* block)
 {
-    for (block_info_t* block = mem_block_list_head; ; block = block->next)
+    int fl;
+    int sl;
+    tlsf_mapping(block->size, &fl, &sl);
+
+    if (block->prev_free != NULL)
     {
-        if (block->is_free && block->size >= (numbytes + sizeof(block_info_t)))
+        block->prev_free->next_free = block->next_free;
+    }
+    else
+    {
+        __free_lists[fl][sl] = block->next_free;
+        if (block->next_free == NULL)
         {
-            return block;
+            __sl_bitmap[fl] &= ~(1 << sl);
+            if (__sl_bitmap[fl] == 0)
+            {
+                __fl_bitmap &= ~(1 << fl);
+            }
         }
+    }
 
-        if (block->next == NULL)
+    if (block->next_free != NULL)
+    {
+        block->next_free->prev_free = block->prev_free;
+    }
+}
+
+/**
+ * @brief Find a free block of at least a given size.
+ *
+ * The size is rounded up to the next class boundary first, so any block in the
+ * class found is big enough and the first one can be taken without comparing.
+ */
+static block_info_t* free_list_find(uint32_t size)
+{
+    if (size >= TLSF_SMALL_SIZE)
+    {
+        size += (1 << (bit_fls(size) - TLSF_SL_LOG2)) - 1;
+    }
+
+    int fl;
+    int sl;
+    tlsf_mapping(size, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT)
+    {
+        return NULL;
+    }
+
+    // Bigger class in the same row, or else the smallest class of a bigger row.
+    uint32_t sl_map = __sl_bitmap[fl] & (~0U << sl);
+    if (sl_map == 0)
+    {
+        uint32_t fl_map = (fl + 1 < TLSF_FL_COUNT) ? (__fl_bitmap & (~0U << (fl + 1))) : 0;
+        if (fl_map == 0)
         {
-            break;
+            return NULL;
+        }
+        fl = bit_ffs(fl_map);
+        sl_map = __sl_bitmap[fl];
+    }
+    sl = bit_ffs(sl_map);
+
+    return __free_lists[fl][sl];
+}
+
+/** @brief Mark a block taken off the free lists as used, and give whatever it has beyond size back. */
+static void block_use(block_info_t* block, uint32_t size)
+{
+    uint32_t remaining = block->size - size;
+    if (remaining >= BLOCK_MIN_SIZE)
+    {
+        block_set_size(block, size, BLOCK_USED);
+        block_info_t* rest = block_next(block);
+        block_set_size(rest, remaining, 0);
+        free_list_insert(rest);
+    }
+    else
+    {
+        block->size |= BLOCK_USED;
+    }
+}
+
+/** @brief Check whether a buffer ends exactly at a multiple of a boundary, see #malloc_dma. */
+static inline bool ends_at_boundary(uintptr_t start, size_t numbytes, uint32_t boundary)
+{
+    return (boundary != 0) && (((start + numbytes) & (boundary - 1)) == 0);
+}
+
+/**
+ * @brief Allocate with a payload alignment above #HEAP_ALIGN, and optionally not ending at a boundary.
+ *
+ * The block found has room to move the payload forward. The gap left in front of
+ * it becomes a free block of its own, so free() needs nothing extra to find the header.
+ */
+static void* malloc_placed(size_t numbytes, uint32_t align, uint32_t avoid_boundary)
+{
+    uint32_t heap_size = KERNEL_HEAP_END - KERNEL_HEAP_START;
+    if ((numbytes == 0) || (numbytes > heap_size) || (align & (align - 1)) || (align > heap_size) ||
+        (avoid_boundary & (avoid_boundary - 1)))
+    {
+        return NULL;
+    }
+    if (align < HEAP_ALIGN)
+    {
+        align = HEAP_ALIGN;
+    }
+
+    uint32_t size = sizeof(block_info_t) + ((numbytes + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1));
+
+    // Enough for the alignment, a gap block in front, and a step off the boundary.
+    uint32_t slack = BLOCK_MIN_SIZE + (avoid_boundary ? 3 : 2) * align;
+    if (size > heap_size - slack)
+    {
+        return NULL;
+    }
+
+    block_info_t* block = free_list_find(size + slack);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    uintptr_t first = (uintptr_t) (block + 1);
+    uintptr_t payload = (first + align - 1) & ~(uintptr_t) (align - 1);
+    while (((payload != first) && (payload - first < BLOCK_MIN_SIZE)) || ends_at_boundary(payload, numbytes, avoid_boundary))
+    {
+        payload += align;
+        if (payload - first > slack)
+        {
+            // Only when no placement at this alignment can avoid the boundary.
+            return NULL;
+        }
+    }
+
+    free_list_remove(block);
+
+    if (payload != first)
+    {
+        // The block before is in use (free blocks never touch), so the gap stays a separate free block.
+        block_info_t* aligned = (block_info_t*) payload - 1;
+        uint32_t gap = (uint8_t*) aligned - (uint8_t*) block;
+        uint32_t total = block->size;
+        block_set_size(block, gap, 0);
+        block_set_size(aligned, total - gap, 0);
+        free_list_insert(block);
+        block = aligned;
+    }
+
+    block_use(block, size);
+
+    return block + 1;
+}
+
+void malloc_init(void)
+{
+    __heap_start = (block_info_t*) (uintptr_t) KERNEL_HEAP_START;
+    __heap_end = (block_info_t*) (uintptr_t) KERNEL_HEAP_END;
+    __fl_bitmap = 0;
+    for (int fl = 0; fl < TLSF_FL_COUNT; fl++)
+    {
+        __sl_bitmap[fl] = 0;
+        for (int sl = 0; sl < TLSF_SL_COUNT; sl++)
+        {
+            __free_lists[fl][sl] = NULL;
+        }
+    }
+
+    __heap_start->prev_size = 0;
+    block_set_size(__heap_start, KERNEL_HEAP_END - KERNEL_HEAP_START, 0);
+    free_list_insert(__heap_start);
+}
+
+void free(void* first_byte)
+{
+    if (first_byte == NULL)
+    {
+        return;
+    }
+
+    // Memory from malloc_uncached is the same block seen through KSEG1.
+    block_info_t* block = (block_info_t*) ADDR_TO_KSEG0(ADDR_TO_PHYS((uintptr_t) first_byte)) - 1;
+
+    assert((block >= __heap_start) && (block < __heap_end) && !((uintptr_t) block & (HEAP_ALIGN - 1)),
+           "free: Pointer doesn't come from malloc.");
+    assert(block->size & BLOCK_USED, "free: Block is already free.");
+
+    uint32_t size = block_size(block);
+
+#ifdef KIVOS_DEBUG
+    // malloc_uncached dropped the block's lines from the cache. Any line back in
+    // it means the memory was also accessed through KSEG0.
+    if (((uintptr_t) first_byte & 0xE0000000) == MEM_KSEG1_BASE)
+    {
+        assert(!data_cache_range_resident(block + 1, size - sizeof(block_info_t)),
+               "free: Uncached allocation was accessed through the cache.");
+    }
+#endif
+
+    block_info_t* next = block_next(block);
+    if ((next < __heap_end) && !(next->size & BLOCK_USED))
+    {
+        free_list_remove(next);
+        size += next->size;
+    }
+
+    if (block != __heap_start)
+    {
+        block_info_t* prev = (block_info_t*) ((uint8_t*) block - block->prev_size);
+        if (!(prev->size & BLOCK_USED))
+        {
+            free_list_remove(prev);
+            size += prev->size;
+            block = prev;
         }
     }
 
-    return NULL;
+    block_set_size(block, size, 0);
+    free_list_insert(block);
 }
 
 void* malloc(size_t numbytes)
 {
-    if (numbytes == 0)
+    if ((numbytes == 0) || (numbytes > (size_t) (KERNEL_HEAP_END - KERNEL_HEAP_START)))
     {
         return NULL;
     }
 
-    size_t alignment_offset = (numbytes % 16);
-    size_t numbytes_aligned = (alignment_offset != 0) ? numbytes + (16 - alignment_offset) : numbytes;
+    uint32_t size = sizeof(block_info_t) + ((numbytes + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1));
 
-    block_info_t* block = find_free_block(numbytes_aligned);
-    if (!block)
+    block_info_t* block = free_list_find(size);
+    if (block == NULL)
     {
         return NULL;
     }
 
-    void* allocated_mem = ((void*) block) + sizeof(block_info_t);
+    free_list_remove(block);
+    block_use(block, size);
 
-    block_info_t* new_block = (block_info_t*) (allocated_mem + numbytes_aligned);
-    new_block->prev = block->prev;
-    new_block->next = block;
-    new_block->is_free = true;
-    new_block->size = block->size - numbytes_aligned - sizeof(block_info_t);
+    return block + 1;
+}
 
-    block->prev = new_block;
-    block->size = numbytes_aligned;
-    block->is_free = false;
+void* malloc_aligned(size_t numbytes, uint32_t align)
+{
+    if (align <= HEAP_ALIGN)
+    {
+        return malloc(numbytes);
+    }
 
-    // If we allocated into block in list head,
-    // make new block the new head now.
-    if (block == mem_block_list_head)
+    return malloc_placed(numbytes, align, 0);
+}
+
+void* malloc_dma(size_t numbytes, uint32_t align, uint32_t avoid_boundary)
+{
+    void* mem = malloc_placed(numbytes, align, avoid_boundary);
+    if (mem != NULL)
     {
-        mem_block_list_head = new_block;
+        // Dirty lines left over from earlier use of the memory must not be
+        // written back over data the hardware puts there.
+        data_cache_range_writeback_invalidate(mem, (numbytes + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1));
     }
 
-    return allocated_mem;
+    return mem;
 }
 
 void* malloc_uncached(size_t numbytes)
 {
-    uint32_t mem_uncached = ADDR_TO_KSEG1((uint32_t) malloc(numbytes));
-    return (void*) mem_uncached;
+    // Whole lines, so no cached data can share one with the block.
+    size_t size = (numbytes + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+    void* mem = malloc(size);
+    if (mem == NULL)
+    {
+        return NULL;
+    }
+
+    // Dirty lines left over from earlier cached use of the memory would otherwise
+    // be evicted on top of whatever gets written through KSEG1 or by DMA.
+    data_cache_hit_writeback_invalidate(mem, size);
+
+    return (void*) ADDR_TO_KSEG1((uintptr_t) mem);
+}
+
+bool malloc_get_stats(heap_stats_t* stats)
+{
+    *stats = (heap_stats_t) {.total = (uint8_t*) __heap_end - (uint8_t*) __heap_start};
+
+    bool valid = true;
+    uint32_t prev_size = 0;
+    bool prev_free = false;
+    block_info_t* block = __heap_start;
+    while (block < __heap_end)
+    {
+        uint32_t size = block_size(block);
+        bool is_free = !(block->size & BLOCK_USED);
+
+        // Every block must be aligned, carry the right boundary tag, and no two
+        // free blocks may be left next to each other.
+        if ((size < BLOCK_MIN_SIZE) || (size & (HEAP_ALIGN - 1)) || (block->prev_size != prev_size) || (is_free && prev_free))
+        {
+            valid = false;
+            break;
+        }
+
+        if (is_free)
+        {
+            stats->free_bytes += size;
+            stats->free_blocks++;
+            if (size - sizeof(block_info_t) > stats->largest_free)
+            {
+                stats->largest_free = size - sizeof(block_info_t);
+            }
+        }
+        else
+        {
+            stats->used_bytes += size;
+            stats->used_blocks++;
+        }
+
+        prev_size = size;
+        prev_free = is_free;
+        block = block_next(block);
+    }
+
+    // The free lists must hold exactly the free blocks, each in its own class.
+    uint32_t listed = 0;
+    for (int fl = 0; valid && (fl < TLSF_FL_COUNT); fl++)
+    {
+        if (!!(__fl_bitmap & (1 << fl)) != (__sl_bitmap[fl] != 0))
+        {
+            valid = false;
+        }
+
+        for (int sl = 0; valid && (sl < TLSF_SL_COUNT); sl++)
+        {
+            if (!!(__sl_bitmap[fl] & (1 << sl)) != (__free_lists[fl][sl] != NULL))
+            {
+                valid = false;
+            }
+
+            for (block_info_t* free_block = __free_lists[fl][sl]; valid && (free_block != NULL); free_block = free_block->next_free)
+            {
+                int block_fl;
+                int block_sl;
+                tlsf_mapping(free_block->size, &block_fl, &block_sl);
+                if ((free_block->size & BLOCK_USED) || (block_fl != fl) || (block_sl != sl) || (++listed > stats->free_blocks))
+                {
+                    valid = false;
+                }
+            }
+        }
+    }
+
+    return valid && (block == __heap_end) && (listed == stats->free_blocks);
 }
@@ -0,0 +1,103 @@
+/**
+ * @file pool.c
+ * @brief This module creates fixed-size object pools, see pool_t.
+ *
+ * Allocating and freeing objects is inline in pool.h, so that userspace can work on
+ * pools in the user segment without going through a syscall for every object.
+ */
+
+#include "pool.h"
+#include "memory.h"
+#include "system.h"
+
+/** @brief Size of the pool header in front of the objects, so that the objects start on a new cache line. */
+#define POOL_HEADER_SIZE        ((sizeof(pool_t) + 15) & ~15)
+
+/** @brief Get the distance between objects, they have to hold at least the free list link. */
+static uint32_t pool_stride(uint32_t obj_size, uint32_t flags)
+{
+    uint32_t align = (flags & POOL_FLAGS_ALIGN_LINE) ? 16 : 4;
+    if (obj_size < sizeof(void*))
+    {
+        obj_size = sizeof(void*);
+    }
+
+    return (obj_size + align - 1) & ~(align - 1);
+}
+
+/** @brief Check that a pool's header and objects fit into 32 bits. */
+static bool pool_size_valid(uint32_t stride, uint32_t count)
+{
+    return (count > 0) && (stride <= (0xFFFFFFFF - POOL_HEADER_SIZE) / count);
+}
+
+/** @brief Fill in the header and link all objects into the free list, lowest address first. */
+static void pool_init(pool_t* pool, uint8_t* objects, uint32_t stride, uint32_t count, uint32_t flags)
+{
+    pool->free_list = objects;
+    pool->obj_size = stride;
+    pool->count = count;
+    pool->free_count = count;
+    pool->flags = flags;
+    pool->objects = objects;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint8_t* obj = objects + (i * stride);
+        *(void**) obj = (i + 1 < count) ? (obj + stride) : NULL;
+    }
+}
+
+pool_t* pool_create(uint32_t obj_size, uint32_t count, uint32_t flags)
+{
+    uint32_t stride = pool_stride(obj_size, flags);
+    if (!pool_size_valid(stride, count))
+    {
+        return NULL;
+    }
+
+    pool_t* pool = malloc(POOL_HEADER_SIZE + (stride * count));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+
+    uint8_t* objects = (uint8_t*) pool + POOL_HEADER_SIZE;
+    if (flags & POOL_FLAGS_UNCACHED)
+    {
+        // Lines left over from earlier cached use of the memory must not be
+        // written back over objects written through KSEG1.
+        data_cache_range_writeback_invalidate(objects, stride * count);
+        objects = (uint8_t*) ADDR_TO_KSEG1((uintptr_t) objects);
+    }
+
+    pool_init(pool, objects, stride, count, flags);
+
+    return pool;
+}
+
+pool_t* pool_create_useg(uint32_t obj_size, uint32_t count, uint32_t flags)
+{
+    uint32_t stride = pool_stride(obj_size, flags);
+    if ((flags & POOL_FLAGS_UNCACHED) || !pool_size_valid(stride, count))
+    {
+        return NULL;
+    }
+
+    // The user segment is mapped by a global TLB entry, so the kernel can build
+    // the pool at the addresses userspace will use.
+    pool_t* pool = user_region_alloc(POOL_HEADER_SIZE + (stride * count));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+
+    pool_init(pool, (uint8_t*) pool + POOL_HEADER_SIZE, stride, count, flags);
+
+    return pool;
+}
+
+void pool_destroy(pool_t* pool)
+{
+    free(pool);
+}
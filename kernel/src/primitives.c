@@ -0,0 +1,267 @@
+/**
+ * @file primitives.c
+ * @brief This module draws lines, rectangles and circles.
+ *
+ * Every shape is broken down into horizontal spans that are clipped one by one
+ * and written with #graphics_fill_span or #graphics_blend_span. Spans of a shape
+ * never overlap, so the alpha variants blend every pixel exactly once.
+ */
+
+#include "primitives.h"
+#include "rdp.h"
+
+/** @brief Writes the pixels of an unclipped span, either opaque or blended. */
+typedef void (*span_func_t)(surface_t* surface, int x0, int x1, int y, uint32_t color);
+
+/** @brief Clip a span with inclusive ends to the surface and draw it. */
+static inline void primitive_span(surface_t* dst, int x0, int x1, int y, uint32_t color, span_func_t span)
+{
+    if ((y < 0) || (y >= (int) dst->height))
+    {
+        return;
+    }
+    if (x0 > x1)
+    {
+        int tmp = x0;
+        x0 = x1;
+        x1 = tmp;
+    }
+
+    x0 = (x0 > 0) ? x0 : 0;
+    x1 = (x1 < (int) dst->width - 1) ? x1 : ((int) dst->width - 1);
+    if (x0 <= x1)
+    {
+        span(dst, x0, x1 + 1, y, color);
+    }
+}
+
+/**
+ * @brief Prepare for drawing a shape with the given inclusive bounding box.
+ *
+ * @return False if nothing of the shape is visible.
+ */
+static bool primitive_begin(surface_t* dst, int x0, int y0, int x1, int y1)
+{
+    if ((dst->buffer == NULL) || (x1 < 0) || (y1 < 0) || (x0 >= (int) dst->width) || (y0 >= (int) dst->height))
+    {
+        return false;
+    }
+
+    display_mark_dirty(dst, (x0 > 0) ? x0 : 0, (y0 > 0) ? y0 : 0,
+                       (x1 < (int) dst->width) ? (x1 + 1) : dst->width,
+                       (y1 < (int) dst->height) ? (y1 + 1) : dst->height);
+
+    // Don't race with the RDP.
+    rdp_wait_surface(dst);
+
+    return true;
+}
+
+static void line(surface_t* dst, int x0, int y0, int x1, int y1, uint32_t color, span_func_t span)
+{
+    // Always walk downwards, so we can stop at the bottom edge.
+    if (y0 > y1)
+    {
+        int tmp = x0; x0 = x1; x1 = tmp;
+        tmp = y0; y0 = y1; y1 = tmp;
+    }
+
+    if (!primitive_begin(dst, (x0 < x1) ? x0 : x1, y0, (x0 > x1) ? x0 : x1, y1))
+    {
+        return;
+    }
+
+    int dx = (x1 > x0) ? (x1 - x0) : (x0 - x1);
+    int dy = y1 - y0;
+    int sx = (x0 < x1) ? 1 : -1;
+    int err = dx - dy;
+    int span_start = x0;
+
+    // Bresenham, but pixels on the same row are collected into one span.
+    while ((x0 != x1) || (y0 != y1))
+    {
+        int e2 = 2 * err;
+        int prev_x = x0;
+
+        if (e2 > -dy)
+        {
+            err -= dy;
+            x0 += sx;
+        }
+        if (e2 < dx)
+        {
+            err += dx;
+            primitive_span(dst, span_start, prev_x, y0, color, span);
+            y0++;
+            span_start = x0;
+
+            if (y0 >= (int) dst->height)
+            {
+                return;
+            }
+        }
+    }
+
+    primitive_span(dst, span_start, x0, y0, color, span);
+}
+
+static void rect(surface_t* dst, int x, int y, int width, int height, uint32_t color, span_func_t span)
+{
+    if ((width <= 0) || (height <= 0) || !primitive_begin(dst, x, y, x + width - 1, y + height - 1))
+    {
+        return;
+    }
+
+    int x1 = x + width - 1;
+    int y1 = y + height - 1;
+
+    primitive_span(dst, x, x1, y, color, span);
+    for (int row = y + 1; row < y1; row++)
+    {
+        primitive_span(dst, x, x, row, color, span);
+        if (x1 != x)
+        {
+            primitive_span(dst, x1, x1, row, color, span);
+        }
+    }
+    if (y1 != y)
+    {
+        primitive_span(dst, x, x1, y1, color, span);
+    }
+}
+
+static void fill_rect_spans(surface_t* dst, int x, int y, int width, int height, uint32_t color, span_func_t span)
+{
+    if ((width <= 0) || (height <= 0) || !primitive_begin(dst, x, y, x + width - 1, y + height - 1))
+    {
+        return;
+    }
+
+    int y0 = (y > 0) ? y : 0;
+    int y1 = (y + height < (int) dst->height) ? (y + height) : dst->height;
+    for (int row = y0; row < y1; row++)
+    {
+        primitive_span(dst, x, x + width - 1, row, color, span);
+    }
+}
+
+/**
+ * @brief Half width of a circle's row.
+ *
+ * Steps #half_width down from its value for the previous row, which keeps
+ * the whole circle at O(radius) without square roots. Rows past the radius
+ * have a half width of -1.
+ */
+static inline int circle_half_width(int half_width, int row, int radius)
+{
+    int limit = radius * radius + radius;
+    while ((half_width >= 0) && ((half_width * half_width) + (row * row) > limit))
+    {
+        half_width--;
+    }
+
+    return half_width;
+}
+
+static void circle(surface_t* dst, int cx, int cy, int radius, bool filled, uint32_t color, span_func_t span)
+{
+    if ((radius < 0) || !primitive_begin(dst, cx - radius, cy - radius, cx + radius, cy + radius))
+    {
+        return;
+    }
+
+    int half_width = circle_half_width(radius, 0, radius);
+
+    for (int row = 0; row <= radius; row++)
+    {
+        int next_half_width = circle_half_width(half_width, row + 1, radius);
+
+        if (filled)
+        {
+            primitive_span(dst, cx - half_width, cx + half_width, cy - row, color, span);
+            if (row != 0)
+            {
+                primitive_span(dst, cx - half_width, cx + half_width, cy + row, color, span);
+            }
+        }
+        else
+        {
+            // The outline is whatever sticks out past the next row further from the center.
+            int inner = next_half_width + 1;
+            inner = (inner < half_width) ? inner : half_width;
+
+            for (int side = -1; side <= 1; side += 2)
+            {
+                int y = cy + (side * row);
+                if (inner <= 0)
+                {
+                    primitive_span(dst, cx - half_width, cx + half_width, y, color, span);
+                }
+                else
+                {
+                    primitive_span(dst, cx - half_width, cx - inner, y, color, span);
+                    primitive_span(dst, cx + inner, cx + half_width, y, color, span);
+                }
+
+                if (row == 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        half_width = next_half_width;
+    }
+}
+
+void graphics_draw_line(surface_t* dst, int x0, int y0, int x1, int y1, uint32_t color)
+{
+    line(dst, x0, y0, x1, y1, color, graphics_fill_span);
+}
+
+void graphics_draw_line_alpha(surface_t* dst, int x0, int y0, int x1, int y1, uint32_t color)
+{
+    line(dst, x0, y0, x1, y1, color, graphics_blend_span);
+}
+
+void graphics_draw_rect(surface_t* dst, int x, int y, int width, int height, uint32_t color)
+{
+    rect(dst, x, y, width, height, color, graphics_fill_span);
+}
+
+void graphics_draw_rect_alpha(surface_t* dst, int x, int y, int width, int height, uint32_t color)
+{
+    rect(dst, x, y, width, height, color, graphics_blend_span);
+}
+
+void graphics_fill_rect_alpha(surface_t* dst, int x, int y, int width, int height, uint32_t color)
+{
+    // Opaque rectangles can go to the RDP.
+    if ((color & 0xFF) == 0xFF)
+    {
+        graphics_fill_rect(dst, x, y, width, height, color);
+        return;
+    }
+
+    fill_rect_spans(dst, x, y, width, height, color, graphics_blend_span);
+}
+
+void graphics_draw_circle(surface_t* dst, int cx, int cy, int radius, uint32_t color)
+{
+    circle(dst, cx, cy, radius, false, color, graphics_fill_span);
+}
+
+void graphics_draw_circle_alpha(surface_t* dst, int cx, int cy, int radius, uint32_t color)
+{
+    circle(dst, cx, cy, radius, false, color, graphics_blend_span);
+}
+
+void graphics_fill_circle(surface_t* dst, int cx, int cy, int radius, uint32_t color)
+{
+    circle(dst, cx, cy, radius, true, color, graphics_fill_span);
+}
+
+void graphics_fill_circle_alpha(surface_t* dst, int cx, int cy, int radius, uint32_t color)
+{
+    circle(dst, cx, cy, radius, true, color, graphics_blend_span);
+}
@@ -0,0 +1,451 @@
+/**
+ * @file rdp.c
+ * @brief This module builds command lists for the RDP and submits them via the DPC registers.
+ *
+ * The RDP is the rasterizer half of the RCP. It reads 64-bit commands from RDRAM
+ * and draws into a framebuffer without any involvement of the CPU. We only use it
+ * for two simple things: filling rectangles with a solid color (FILL mode) and
+ * drawing alpha-blended textured rectangles (1-cycle mode with the blender).
+ *
+ * Commands are appended into a single buffer. Once a batch is ready, it is handed
+ * over to the RDP by writing its start and end addresses into the DPC registers.
+ * Every batch ends with SYNC_FULL which raises the DP interrupt once the RDP has
+ * finished writing all pixels to RDRAM.
+ *
+ * Batches are numbered, and a fence is simply the number of a batch. The last batch
+ * that drew into or textured from each surface is remembered, so the CPU only has to
+ * wait for the RDP when it touches a surface the RDP is still using. That lets the CPU
+ * build the next frame while the RDP is rasterizing the previous one.
+ */
+
+#include "dp.h"
+#include "rdp.h"
+#include "system.h"
+#include "interrupt.h"
+
+/** @brief Size of the command buffer in 64-bit words. */
+#define RDP_BUFFER_SIZE             (1024)
+/** @brief Maximum number of words a single drawing operation appends (plus SYNC_FULL). */
+#define RDP_MAX_OP_SIZE             (24)
+
+/** @brief Maximum number of framebuffers and textures whose last batch is remembered. */
+#define RDP_MAX_TRACKED             (16)
+
+/** @brief Size of TMEM in bytes. 32-bit textures are split in two halves. */
+#define RDP_TMEM_SIZE               (4096)
+
+// Command IDs.
+#define RDP_CMD_TEXTURE_RECTANGLE   (0x24)
+#define RDP_CMD_SYNC_LOAD           (0x26)
+#define RDP_CMD_SYNC_PIPE           (0x27)
+#define RDP_CMD_SYNC_TILE           (0x28)
+#define RDP_CMD_SYNC_FULL           (0x29)
+#define RDP_CMD_SET_SCISSOR         (0x2D)
+#define RDP_CMD_SET_OTHER_MODES     (0x2F)
+#define RDP_CMD_SET_TILE_SIZE       (0x32)
+#define RDP_CMD_LOAD_TILE           (0x34)
+#define RDP_CMD_SET_TILE            (0x35)
+#define RDP_CMD_FILL_RECTANGLE      (0x36)
+#define RDP_CMD_SET_FILL_COLOR      (0x37)
+#define RDP_CMD_SET_COMBINE_MODE    (0x3C)
+#define RDP_CMD_SET_TEXTURE_IMAGE   (0x3D)
+#define RDP_CMD_SET_COLOR_IMAGE     (0x3F)
+
+// Image formats and texel sizes.
+#define RDP_FORMAT_RGBA             (0)
+#define RDP_SIZE_16                 (2)
+#define RDP_SIZE_32                 (3)
+
+// Tile descriptors.
+#define RDP_TILE_RENDER             (0)
+#define RDP_TILE_LOAD               (7)
+
+// Other modes.
+#define RDP_SOM_CYCLE_1             (0ULL << 52)    // 1-cycle mode (texturing + blending).
+#define RDP_SOM_CYCLE_FILL          (3ULL << 52)    // Fill mode (solid color, fastest).
+#define RDP_SOM_TF0_RGB             (1ULL << 43)    // Bypass YUV conversion for texel 0.
+#define RDP_SOM_TF1_RGB             (2ULL << 41)    // Bypass YUV conversion for texel 1.
+#define RDP_SOM_RGBDITHER_NONE      (3ULL << 38)    // No color dithering.
+#define RDP_SOM_ALPHADITHER_NONE    (3ULL << 36)    // No alpha dithering.
+#define RDP_SOM_BLEND_M_MEM         ((1ULL << 22) | (1ULL << 20))   // Blender: IN * IN_ALPHA + MEM * (1 - IN_ALPHA).
+#define RDP_SOM_FORCE_BLEND         (1ULL << 14)    // Always run the blender.
+#define RDP_SOM_IMAGE_READ          (1ULL << 6)     // Read the framebuffer (needed for MEM color).
+
+/** @brief Other modes for drawing solid fills. */
+#define RDP_MODES_FILL              (RDP_SOM_CYCLE_FILL)
+/** @brief Other modes for drawing alpha-blended textures. */
+#define RDP_MODES_BLEND             (RDP_SOM_CYCLE_1 | RDP_SOM_TF0_RGB | RDP_SOM_TF1_RGB | \
+                                     RDP_SOM_RGBDITHER_NONE | RDP_SOM_ALPHADITHER_NONE | \
+                                     RDP_SOM_BLEND_M_MEM | RDP_SOM_FORCE_BLEND | RDP_SOM_IMAGE_READ)
+
+/**
+ * @brief Color combiner setting which passes TEX0 color and alpha through unchanged.
+ *
+ * Formula is (A - B) * C + D for both cycles, with A, B, C set to zero and D set to TEX0.
+ */
+#define RDP_COMBINE_TEX0            ((8ULL << 52) | (16ULL << 47) | (7ULL << 44) | (7ULL << 41) | \
+                                     (8ULL << 37) | (16ULL << 32) | (8ULL << 28) | (8ULL << 24) | \
+                                     (7ULL << 21) | (7ULL << 18) | (1ULL << 15) | (7ULL << 12) | \
+                                     (1ULL << 9)  | (1ULL << 6)  | (7ULL << 3)  | (1ULL << 0))
+
+/** @brief Build the first word of a command from its ID. */
+#define RDP_CMD(id)                 (((uint64_t) (id)) << 56)
+/** @brief Convert integer pixel coordinate to 10.2 fixed point. */
+#define RDP_FX(value)               (((uint64_t) (value) << 2) & 0xFFF)
+
+typedef enum
+{
+    RDP_MODE_NONE,
+    RDP_MODE_FILL,
+    RDP_MODE_BLEND
+} rdp_mode_t;
+
+/** @brief Command buffer. Only ever accessed through its uncached alias. */
+static uint64_t __rdp_commands[RDP_BUFFER_SIZE] __attribute__((aligned(16)));
+/** @brief Uncached pointer to the command buffer. */
+static volatile uint64_t* __rdp_buffer;
+/** @brief Index of the next command word to write. */
+static int __rdp_write = 0;
+/** @brief Index of the first command word not yet sent to the RDP. */
+static int __rdp_sent = 0;
+/** @brief Number of batches sent to the RDP. The batch being built gets the next number. */
+static uint32_t __rdp_submitted = 0;
+/** @brief Number of batches the RDP has finished. */
+static volatile uint32_t __rdp_completed = 0;
+
+/** @brief Last batch drawing into or texturing from a surface. */
+typedef struct rdp_surface_fence_s
+{
+    uint32_t phys;      // Physical address of the surface buffer.
+    uint32_t fence;     // Number of the batch.
+} rdp_surface_fence_t;
+
+/** @brief Surfaces the RDP has drawn into or read from recently. */
+static rdp_surface_fence_t __rdp_surface_fences[RDP_MAX_TRACKED];
+/** @brief Number of valid entries in #__rdp_surface_fences. */
+static int __rdp_surface_count = 0;
+
+/** @brief Framebuffer the RDP currently renders to. */
+static void* __rdp_target = NULL;
+/** @brief Current other modes setting. */
+static rdp_mode_t __rdp_mode = RDP_MODE_NONE;
+/** @brief Current fill color. */
+static uint32_t __rdp_fill_color = 0;
+/** @brief Whether #__rdp_fill_color has been sent to the RDP yet. */
+static bool __rdp_fill_color_valid = false;
+
+/**
+ * @brief Interrupt handler for the DP interrupt.
+ *
+ * The RDP has processed SYNC_FULL at the end of the last batch,
+ * meaning all pixels have been written to RDRAM.
+ */
+void __rdp_callback(void)
+{
+    __rdp_completed++;
+}
+
+void rdp_init(void)
+{
+    __rdp_buffer = (volatile uint64_t*) ADDR_TO_KSEG1((uintptr_t) __rdp_commands);
+    // Make sure no dirty cache line gets evicted on top of commands written through the uncached alias.
+    data_cache_hit_writeback_invalidate(__rdp_commands, sizeof(__rdp_commands));
+
+    __rdp_write = 0;
+    __rdp_sent = 0;
+    __rdp_submitted = 0;
+    __rdp_completed = 0;
+    __rdp_surface_count = 0;
+    __rdp_target = NULL;
+    __rdp_mode = RDP_MODE_NONE;
+    __rdp_fill_color_valid = false;
+
+    // Read commands from RDRAM and make sure the RDP isn't stuck from before reset.
+    DP_regs->status = DP_STATUS_CLR_XBUS | DP_STATUS_CLR_FREEZE | DP_STATUS_CLR_FLUSH;
+
+    interrupt_set_DP(true);
+}
+
+static inline void rdp_push(uint64_t command)
+{
+    __rdp_buffer[__rdp_write++] = command;
+}
+
+void rdp_flush(void)
+{
+    if (__rdp_write == __rdp_sent)
+    {
+        return;
+    }
+
+    rdp_push(RDP_CMD(RDP_CMD_SYNC_FULL));
+
+    // Only one batch can be in flight at a time.
+    rdp_wait_fence(__rdp_submitted);
+
+    __rdp_submitted++;
+    DP_regs->start = ADDR_TO_PHYS((uintptr_t) &__rdp_commands[__rdp_sent]);
+    DP_regs->end = ADDR_TO_PHYS((uintptr_t) &__rdp_commands[__rdp_write]);
+
+    __rdp_sent = __rdp_write;
+}
+
+void rdp_wait(void)
+{
+    rdp_flush();
+    rdp_wait_fence(__rdp_submitted);
+}
+
+uint32_t rdp_fence(void)
+{
+    rdp_flush();
+    return __rdp_submitted;
+}
+
+bool rdp_fence_done(uint32_t fence)
+{
+    return (int32_t) (__rdp_completed - fence) >= 0;
+}
+
+void rdp_wait_fence(uint32_t fence)
+{
+    while (!rdp_fence_done(fence)) {}
+}
+
+void rdp_wait_surface(surface_t* surface)
+{
+    uint32_t phys = ADDR_TO_PHYS((uintptr_t) surface->buffer);
+
+    for (int i = 0; i < __rdp_surface_count; i++)
+    {
+        if (__rdp_surface_fences[i].phys != phys)
+        {
+            continue;
+        }
+
+        // Commands for it might still be waiting in the batch being built.
+        if (__rdp_surface_fences[i].fence == __rdp_submitted + 1)
+        {
+            rdp_flush();
+        }
+        rdp_wait_fence(__rdp_surface_fences[i].fence);
+        return;
+    }
+}
+
+/** @brief Remember that the batch being built draws into or reads from a surface. */
+static void rdp_track_surface(surface_t* surface)
+{
+    uint32_t phys = ADDR_TO_PHYS((uintptr_t) surface->buffer);
+
+    int free = -1;
+    for (int i = 0; i < __rdp_surface_count; i++)
+    {
+        if (__rdp_surface_fences[i].phys == phys)
+        {
+            __rdp_surface_fences[i].fence = __rdp_submitted + 1;
+            return;
+        }
+        if (rdp_fence_done(__rdp_surface_fences[i].fence))
+        {
+            free = i;
+        }
+    }
+
+    if (__rdp_surface_count < RDP_MAX_TRACKED)
+    {
+        free = __rdp_surface_count++;
+    }
+    else if (free < 0)
+    {
+        // Every tracked surface is still busy. Wait them all out rather than lose track.
+        rdp_wait();
+        free = 0;
+    }
+
+    // Read the fence only now. The wait above submitted the batch being built, so the surface's commands go to the next one.
+    __rdp_surface_fences[free] = (rdp_surface_fence_t) {.phys = phys, .fence = __rdp_submitted + 1};
+}
+
+/** @brief Make sure the next drawing operation fits into the command buffer. */
+static void rdp_reserve(void)
+{
+    if (__rdp_write + RDP_MAX_OP_SIZE < RDP_BUFFER_SIZE)
+    {
+        return;
+    }
+
+    // Buffer is full. Wait for the RDP to consume everything and start over.
+    rdp_wait();
+    __rdp_write = 0;
+    __rdp_sent = 0;
+}
+
+/** @brief Point the RDP at a new framebuffer, if needed. */
+static void rdp_set_target(surface_t* dst)
+{
+    rdp_track_surface(dst);
+
+    if (__rdp_target == dst->buffer)
+    {
+        return;
+    }
+
+    uint64_t size = (dst->format == FMT_RGBA16) ? RDP_SIZE_16 : RDP_SIZE_32;
+
+    rdp_push(RDP_CMD(RDP_CMD_SYNC_PIPE));
+    rdp_push(RDP_CMD(RDP_CMD_SET_COLOR_IMAGE) | ((uint64_t) RDP_FORMAT_RGBA << 53) | (size << 51) |
+             ((uint64_t) (dst->width - 1) << 32) | ADDR_TO_PHYS((uintptr_t) dst->buffer));
+    rdp_push(RDP_CMD(RDP_CMD_SET_SCISSOR) | (RDP_FX(0) << 44) | (RDP_FX(0) << 32) |
+             (RDP_FX(dst->width) << 12) | RDP_FX(dst->height));
+
+    __rdp_target = dst->buffer;
+}
+
+/**
+ * @brief Make a row range of a cached target coherent before the RDP draws to it.
+ *
+ * Dirty lines have to reach RDRAM before the RDP overwrites them (or they would be
+ * evicted on top of its pixels later), and all lines have to go so that the CPU
+ * reads the RDP's pixels afterwards.
+ */
+static void rdp_flush_target_cache(surface_t* dst, int y0, int y1)
+{
+    if (!(dst->flags & SURFACE_FLAGS_CACHED))
+    {
+        return;
+    }
+
+    uint32_t stride = dst->width * surface_bytes_per_pixel(dst->format);
+    data_cache_range_writeback_invalidate((uint8_t*) dst->buffer + (y0 * stride), (y1 - y0) * stride);
+}
+
+/** @brief Switch the RDP between fill and blend modes, if needed. */
+static void rdp_set_mode(rdp_mode_t mode)
+{
+    if (__rdp_mode == mode)
+    {
+        return;
+    }
+
+    rdp_push(RDP_CMD(RDP_CMD_SYNC_PIPE));
+    if (mode == RDP_MODE_FILL)
+    {
+        rdp_push(RDP_CMD(RDP_CMD_SET_OTHER_MODES) | RDP_MODES_FILL);
+    }
+    else
+    {
+        rdp_push(RDP_CMD(RDP_CMD_SET_OTHER_MODES) | RDP_MODES_BLEND);
+        rdp_push(RDP_CMD(RDP_CMD_SET_COMBINE_MODE) | RDP_COMBINE_TEX0);
+    }
+
+    __rdp_mode = mode;
+}
+
+bool rdp_can_target(surface_t* surface)
+{
+    // Coordinates are 10.2 fixed point, so 1024 would wrap around to 0.
+    return (surface->buffer != NULL) &&
+           (((uintptr_t) surface->buffer & 0x7) == 0) &&
+           (surface->width < 1024) &&
+           (surface->height < 1024);
+}
+
+bool rdp_can_texture(surface_t* surface)
+{
+    // Same for texel coordinates.
+    return (surface->format == FMT_RGBA32) &&
+           (surface->buffer != NULL) &&
+           (((uintptr_t) surface->buffer & 0x7) == 0) &&
+           (surface->width < 1024) &&
+           (surface->height < 1024);
+}
+
+void rdp_fill_rectangle(surface_t* dst, int x0, int y0, int x1, int y1, uint32_t color)
+{
+    if ((x0 >= x1) || (y0 >= y1))
+    {
+        return;
+    }
+
+    rdp_flush_target_cache(dst, y0, y1);
+
+    rdp_reserve();
+    rdp_set_target(dst);
+    rdp_set_mode(RDP_MODE_FILL);
+
+    // In 16-bit mode, the fill color holds two pixels.
+    if (dst->format == FMT_RGBA16)
+    {
+        uint32_t color16 = color_to_rgba16(color);
+        color = (color16 << 16) | color16;
+    }
+
+    if (!__rdp_fill_color_valid || (__rdp_fill_color != color))
+    {
+        rdp_push(RDP_CMD(RDP_CMD_SYNC_PIPE));
+        rdp_push(RDP_CMD(RDP_CMD_SET_FILL_COLOR) | color);
+        __rdp_fill_color = color;
+        __rdp_fill_color_valid = true;
+    }
+
+    // In fill mode, the right edge is inclusive.
+    rdp_push(RDP_CMD(RDP_CMD_FILL_RECTANGLE) | (RDP_FX(x1 - 1) << 44) | (RDP_FX(y1) << 32) |
+             (RDP_FX(x0) << 12) | RDP_FX(y0));
+}
+
+void rdp_draw_surface_alpha(surface_t* dst, int x, int y, surface_t* src, int src_x0, int src_y0, int src_x1, int src_y1)
+{
+    if ((src_x0 >= src_x1) || (src_y0 >= src_y1))
+    {
+        return;
+    }
+
+    // 32-bit textures are split between the two TMEM halves, so each row takes
+    // up 2 bytes per texel in one half. Rows must be padded to 8 bytes.
+    int line_bytes = ((src_x1 - src_x0) * 2 + 7) & ~7;
+    int rows_per_load = (RDP_TMEM_SIZE / 2) / line_bytes;
+
+    // The RDP reads the texture from RDRAM, so make sure it's not stuck in the cache.
+    uint32_t src_phys = ADDR_TO_PHYS((uintptr_t) src->buffer);
+    data_cache_hit_writeback((void*) ADDR_TO_KSEG0(src_phys + (src_y0 * src->width * sizeof(uint32_t))),
+                             (src_y1 - src_y0) * src->width * sizeof(uint32_t));
+    rdp_flush_target_cache(dst, y + src_y0, y + src_y1);
+
+    for (int row = src_y0; row < src_y1; row += rows_per_load)
+    {
+        int row_end = row + rows_per_load;
+        if (row_end > src_y1)
+        {
+            row_end = src_y1;
+        }
+
+        rdp_reserve();
+        rdp_set_target(dst);
+        // The CPU must not overwrite or free the texture while the RDP loads from it.
+        rdp_track_surface(src);
+        rdp_set_mode(RDP_MODE_BLEND);
+
+        // Load a chunk of the texture into TMEM.
+        rdp_push(RDP_CMD(RDP_CMD_SYNC_LOAD));
+        rdp_push(RDP_CMD(RDP_CMD_SET_TEXTURE_IMAGE) | ((uint64_t) RDP_FORMAT_RGBA << 53) | ((uint64_t) RDP_SIZE_32 << 51) |
+                 ((uint64_t) (src->width - 1) << 32) | src_phys);
+        rdp_push(RDP_CMD(RDP_CMD_SET_TILE) | ((uint64_t) RDP_FORMAT_RGBA << 53) | ((uint64_t) RDP_SIZE_32 << 51) |
+                 ((uint64_t) (line_bytes / 8) << 41) | ((uint64_t) RDP_TILE_LOAD << 24));
+        rdp_push(RDP_CMD(RDP_CMD_LOAD_TILE) | (RDP_FX(src_x0) << 44) | (RDP_FX(row) << 32) |
+                 ((uint64_t) RDP_TILE_LOAD << 24) | (RDP_FX(src_x1 - 1) << 12) | RDP_FX(row_end - 1));
+
+        // Describe the loaded chunk for rendering.
+        rdp_push(RDP_CMD(RDP_CMD_SYNC_TILE));
+        rdp_push(RDP_CMD(RDP_CMD_SET_TILE) | ((uint64_t) RDP_FORMAT_RGBA << 53) | ((uint64_t) RDP_SIZE_32 << 51) |
+                 ((uint64_t) (line_bytes / 8) << 41) | ((uint64_t) RDP_TILE_RENDER << 24));
+        rdp_push(RDP_CMD(RDP_CMD_SET_TILE_SIZE) | (RDP_FX(src_x0) << 44) | (RDP_FX(row) << 32) |
+                 ((uint64_t) RDP_TILE_RENDER << 24) | (RDP_FX(src_x1 - 1) << 12) | RDP_FX(row_end - 1));
+
+        // Draw it 1:1. S/T are in 10.5 format and their deltas in 5.10 format.
+        rdp_push(RDP_CMD(RDP_CMD_TEXTURE_RECTANGLE) | (RDP_FX(x + src_x1) << 44) | (RDP_FX(y + row_end) << 32) |
+                 ((uint64_t) RDP_TILE_RENDER << 24) | (RDP_FX(x + src_x0) << 12) | RDP_FX(y + row));
+        rdp_push(((uint64_t) ((src_x0 << 5) & 0xFFFF) << 48) | ((uint64_t) ((row << 5) & 0xFFFF) << 32) |
+                 ((uint64_t) (1 << 10) << 16) | (1 << 10));
+    }
+}
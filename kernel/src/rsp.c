@@ -0,0 +1,174 @@
+/**
+ * @file rsp.c
+ * @brief This module runs tasks on the RSP.
+ *
+ * The RSP is the programmable half of the RCP. It can only execute code from its
+ * 4 KiB IMEM and only access data in its 4 KiB DMEM, so every task consists of
+ * DMA-ing microcode and input data in, letting the RSP run until it executes a
+ * break instruction, and DMA-ing results back out.
+ *
+ * With "interrupt on break" enabled, the break raises the SP interrupt. The
+ * interrupt handler finishes the current task and starts the next queued one,
+ * so the CPU only has to wait when it actually needs the results.
+ */
+
+#include "sp.h"
+#include "rsp.h"
+#include "system.h"
+#include "interrupt.h"
+
+/** @brief Maximum number of queued tasks. */
+#define RSP_QUEUE_SIZE          (8)
+
+/** @brief Queued tasks. The first one is the one currently running. */
+static rsp_task_t* __rsp_queue[RSP_QUEUE_SIZE];
+/** @brief Index of the first queued task. */
+static int __rsp_queue_head = 0;
+/** @brief Number of queued tasks. */
+static volatile int __rsp_queue_count = 0;
+
+static void rsp_dma_wait(void)
+{
+    while (SP_regs->status & (SP_STATUS_DMA_BUSY | SP_STATUS_DMA_FULL)) {}
+}
+
+static void rsp_dma_to_sp(const void* ram, uint32_t size, uint32_t mem_address)
+{
+    assert((((uint32_t) ram) & 0x7) == 0, "rsp_dma_to_sp: RDRAM address must be 8 byte aligned.");
+    assert((size & 0x7) == 0 && size > 0 && size <= SP_MEM_SIZE, "rsp_dma_to_sp: Invalid size.");
+
+    // DMA reads straight from RDRAM so make sure our data isn't sitting in the cache.
+    data_cache_hit_writeback((void*) ram, size);
+
+    interrupt_disable();
+        rsp_dma_wait();
+        SP_regs->mem_address = mem_address;
+        SP_regs->ram_address = ADDR_TO_PHYS((uint32_t) ram);
+        SP_regs->read_length = size - 1;
+        rsp_dma_wait();
+    interrupt_enable();
+}
+
+static void rsp_dma_from_sp(void* ram, uint32_t size, uint32_t mem_address)
+{
+    assert((((uint32_t) ram) & 0x7) == 0, "rsp_dma_from_sp: RDRAM address must be 8 byte aligned.");
+    assert((size & 0x7) == 0 && size > 0 && size <= SP_MEM_SIZE, "rsp_dma_from_sp: Invalid size.");
+
+    // Drop stale cache lines so the CPU sees what the DMA writes.
+    data_cache_hit_invalidate(ram, size);
+
+    interrupt_disable();
+        rsp_dma_wait();
+        SP_regs->mem_address = mem_address;
+        SP_regs->ram_address = ADDR_TO_PHYS((uint32_t) ram);
+        SP_regs->write_length = size - 1;
+        rsp_dma_wait();
+    interrupt_enable();
+}
+
+void rsp_load_code(const void* code, uint32_t size)
+{
+    assert(SP_regs->status & SP_STATUS_HALTED, "rsp_load_code: RSP is running.");
+    rsp_dma_to_sp(code, size, SP_MEM_ADDR_IMEM);
+}
+
+void rsp_load_data(const void* data, uint32_t size, uint32_t offset)
+{
+    assert(SP_regs->status & SP_STATUS_HALTED, "rsp_load_data: RSP is running.");
+    assert(offset + size <= SP_MEM_SIZE, "rsp_load_data: Data doesn't fit into DMEM.");
+    rsp_dma_to_sp(data, size, offset);
+}
+
+void rsp_read_data(void* data, uint32_t size, uint32_t offset)
+{
+    assert(SP_regs->status & SP_STATUS_HALTED, "rsp_read_data: RSP is running.");
+    assert(offset + size <= SP_MEM_SIZE, "rsp_read_data: Data doesn't fit into DMEM.");
+    rsp_dma_from_sp(data, size, offset);
+}
+
+/** @brief Load a task into the RSP and let it run. */
+static void rsp_task_start(rsp_task_t* task)
+{
+    rsp_load_code(task->ucode, task->ucode_size);
+    if (task->data != NULL)
+    {
+        rsp_load_data(task->data, task->data_size, 0);
+    }
+
+    *SP_PC_ADDR = 0;
+    SP_regs->status = SP_STATUS_CLR_BROKE | SP_STATUS_CLR_INTR | SP_STATUS_SET_INTR_BREAK | SP_STATUS_CLR_HALT;
+}
+
+/**
+ * @brief Interrupt handler for the SP interrupt.
+ *
+ * The running task executed break. Collect its output and start the next one.
+ */
+void __rsp_callback(void)
+{
+    if (__rsp_queue_count == 0)
+    {
+        return;
+    }
+
+    rsp_task_t* task = __rsp_queue[__rsp_queue_head];
+
+    // Break halts the RSP, so DMEM can be read now.
+    if (task->output != NULL)
+    {
+        rsp_read_data(task->output, task->output_size, task->output_offset);
+    }
+    task->done = true;
+
+    __rsp_queue_head = (__rsp_queue_head + 1) % RSP_QUEUE_SIZE;
+    __rsp_queue_count--;
+
+    if (__rsp_queue_count > 0)
+    {
+        rsp_task_start(__rsp_queue[__rsp_queue_head]);
+    }
+}
+
+void rsp_init(void)
+{
+    // Stop anything that might still be running and start with a clean slate.
+    SP_regs->status = SP_STATUS_SET_HALT | SP_STATUS_CLR_BROKE | SP_STATUS_CLR_INTR | SP_STATUS_CLR_SSTEP;
+    rsp_dma_wait();
+
+    __rsp_queue_head = 0;
+    __rsp_queue_count = 0;
+
+    interrupt_set_SP(true);
+}
+
+void rsp_task_submit(rsp_task_t* task)
+{
+    task->done = false;
+
+    // Wait for a free slot.
+    while (__rsp_queue_count == RSP_QUEUE_SIZE) {}
+
+    interrupt_disable();
+
+    int tail = (__rsp_queue_head + __rsp_queue_count) % RSP_QUEUE_SIZE;
+    __rsp_queue[tail] = task;
+    __rsp_queue_count++;
+
+    // Kickstart the RSP if this is the only task.
+    if (__rsp_queue_count == 1)
+    {
+        rsp_task_start(task);
+    }
+
+    interrupt_enable();
+}
+
+void rsp_task_wait(rsp_task_t* task)
+{
+    while (!task->done) {}
+}
+
+bool rsp_busy(void)
+{
+    return __rsp_queue_count > 0;
+}
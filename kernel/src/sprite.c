@@ -0,0 +1,65 @@
+/**
+ * @file sprite.c
+ * @brief This module draws batches of sprites out of sprite atlases.
+ */
+
+#include "sprite.h"
+#include "system.h"
+
+/** @brief Check whether draw a goes before draw b. */
+static inline bool sprite_draw_before(const sprite_draw_t* a, const sprite_draw_t* b)
+{
+    if (a->atlas != b->atlas)
+    {
+        return (uint32_t) a->atlas < (uint32_t) b->atlas;
+    }
+
+    return a->y < b->y;
+}
+
+void sprite_batch_draw(surface_t* dst, const sprite_draw_t* draws, int count)
+{
+    assert(count <= SPRITE_BATCH_MAX, "sprite_batch_draw: Too many sprites in one batch.");
+
+    // Make sure we touch draw data in kernel segment.
+    draws = (const sprite_draw_t*) ADDR_TO_KSEG0((uint32_t) draws);
+
+    // Sort indices rather than the draws themselves, they belong to the caller.
+    // Batches are small and mostly sorted from frame to frame, so insertion sort it is.
+    uint16_t order[SPRITE_BATCH_MAX];
+    for (int i = 0; i < count; i++)
+    {
+        int j = i;
+        while ((j > 0) && sprite_draw_before(&draws[i], &draws[order[j - 1]]))
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    const sprite_atlas_t* atlas = NULL;
+    surface_t* texture = NULL;
+    const sprite_frame_t* frames = NULL;
+    uint32_t frame_count = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        const sprite_draw_t* draw = &draws[order[i]];
+
+        // Resolve the atlas only when it changes.
+        if (draw->atlas != atlas)
+        {
+            atlas = draw->atlas;
+            const sprite_atlas_t* kernel_atlas = (const sprite_atlas_t*) ADDR_TO_KSEG0((uint32_t) atlas);
+            texture = (surface_t*) ADDR_TO_KSEG0((uint32_t) kernel_atlas->texture);
+            frames = (const sprite_frame_t*) ADDR_TO_KSEG0((uint32_t) kernel_atlas->frames);
+            frame_count = kernel_atlas->frame_count;
+        }
+
+        assert(draw->frame < frame_count, "sprite_batch_draw: Frame out of range.");
+
+        const sprite_frame_t* frame = &frames[draw->frame];
+        graphics_draw_surface_region_alpha(dst, draw->x, draw->y, texture, frame->x, frame->y, frame->width, frame->height);
+    }
+}
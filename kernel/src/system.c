@@ -2,9 +2,11 @@
 #include "cop0.h"
 #include "cop1.h"
 #include "ai.h"
+#include "dp.h"
 #include "mi.h"
 #include "pi.h"
 #include "si.h"
+#include "sp.h"
 #include "vi.h"
 #include "interrupt.h"
 
@@ -14,9 +16,11 @@ int __boot_tvtype;
 int __boot_resettype;
 
 volatile AI_registers_t* const AI_regs = (AI_registers_t*) AI_REG_BASE;
+volatile DP_registers_t* const DP_regs = (DP_registers_t*) DP_REG_BASE;
 volatile MI_registers_t* const MI_regs = (MI_registers_t*) MI_REG_BASE;
 volatile PI_registers_t* const PI_regs = (PI_registers_t*) PI_REG_BASE;
 volatile SI_registers_t* const SI_regs = (SI_registers_t*) SI_REG_BASE;
+volatile SP_registers_t* const SP_regs = (SP_registers_t*) SP_REG_BASE;
 volatile VI_registers_t* const VI_regs = (VI_registers_t*) VI_REG_BASE;
 
 void cop0_status_reset(void)
@@ -82,6 +86,8 @@ void malloc_init(void);
 void joybus_init(void);
 void audio_init(int frequency);
 void tlb_init(void);
+void rdp_init(void);
+void rsp_init(void);
 
 void init_kernel(void)
 {
@@ -92,6 +98,8 @@ void init_kernel(void)
     malloc_init();
     joybus_init();
     audio_init(22050);
+    rdp_init();
+    rsp_init();
     tlb_init();
 }
 
@@ -0,0 +1,114 @@
+/**
+ * @file tilemap.c
+ * @brief This module draws tile-based background layers.
+ *
+ * Rendering goes row by row over the destination. For every row, we find the
+ * map row and the pixel row within its tiles, then walk across the viewport
+ * copying the matching row of each tile from the tileset in one go.
+ */
+
+#include "tilemap.h"
+#include "system.h"
+#include "rdp.h"
+
+/** @brief Wrap a coordinate into [0, size). */
+static inline int tilemap_wrap(int value, int size)
+{
+    value %= size;
+    return (value < 0) ? (value + size) : value;
+}
+
+void tilemap_draw(surface_t* dst, const tilemap_t* map)
+{
+    // Make sure we touch map data in kernel segment.
+    map = (const tilemap_t*) ADDR_TO_KSEG0((uintptr_t) map);
+    const uint16_t* tiles = (const uint16_t*) ADDR_TO_KSEG0((uintptr_t) map->tiles);
+    surface_t tileset = *(surface_t*) ADDR_TO_KSEG0((uintptr_t) map->tileset);
+    // An uncached tileset must stay uncached, so keep kernel segment addresses as they are.
+    tileset.buffer = (void*) ADDR_USER_TO_KERNEL((uintptr_t) tileset.buffer);
+
+    // Sanity checking
+    if ((dst->buffer == NULL) || (tileset.buffer == NULL))
+    {
+        return;
+    }
+    if ((map->tile_width == 0) || (map->tile_height == 0) || (map->width == 0) || (map->height == 0))
+    {
+        return;
+    }
+
+    // Tiles must fit into the tileset, indices past its last tile are drawn like empty ones.
+    int tiles_per_row = tileset.width / map->tile_width;
+    int tile_count = tiles_per_row * (tileset.height / map->tile_height);
+    if (tile_count == 0)
+    {
+        return;
+    }
+
+    // Exit early if all drawing would go off-surface.
+    if (((map->x + (int) map->view_width) <= 0) ||
+        ((map->y + (int) map->view_height) <= 0) ||
+        (map->x >= (int) dst->width) ||
+        (map->y >= (int) dst->height))
+    {
+        return;
+    }
+
+    clip_area_t clip_area = graphics_clip(dst, map->x, map->y, map->view_width, map->view_height);
+    display_mark_dirty(dst, map->x + clip_area.x_start, map->y + clip_area.y_start, map->x + clip_area.x_end, map->y + clip_area.y_end);
+
+    // Don't race with the RDP.
+    rdp_wait_surface(dst);
+    rdp_wait_surface(&tileset);
+
+    int tile_stride = map->tile_height * tileset.width;
+
+    // Position of the first visible pixel in the map.
+    int map_x = tilemap_wrap(clip_area.x_start + map->scroll_x, map->width * map->tile_width);
+    int map_y = tilemap_wrap(clip_area.y_start + map->scroll_y, map->height * map->tile_height);
+    int first_col = map_x / map->tile_width;
+    int first_tx = map_x % map->tile_width;
+    int tile_row = map_y / map->tile_height;
+    int ty = map_y % map->tile_height;
+
+    for (int row = clip_area.y_start; row < clip_area.y_end; row++)
+    {
+        const uint16_t* map_row = tiles + (tile_row * map->width);
+        int dst_index = (map->x + clip_area.x_start) + ((map->y + row) * dst->width);
+        int remaining = clip_area.x_end - clip_area.x_start;
+        int col = first_col;
+        int tx = first_tx;
+
+        while (remaining > 0)
+        {
+            int count = map->tile_width - tx;
+            count = (count < remaining) ? count : remaining;
+
+            uint16_t tile = map_row[col];
+            if ((tile != TILEMAP_EMPTY) && (tile < tile_count))
+            {
+                int src_index = ((tile / tiles_per_row) * tile_stride) + (ty * tileset.width) +
+                                ((tile % tiles_per_row) * map->tile_width) + tx;
+                graphics_copy_pixels(dst, dst_index, &tileset, src_index, count);
+            }
+
+            dst_index += count;
+            remaining -= count;
+            tx = 0;
+            if (++col == map->width)
+            {
+                col = 0;
+            }
+        }
+
+        // Step to the next pixel row of the map.
+        if (++ty == map->tile_height)
+        {
+            ty = 0;
+            if (++tile_row == map->height)
+            {
+                tile_row = 0;
+            }
+        }
+    }
+}
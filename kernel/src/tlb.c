@@ -1,5 +1,6 @@
 #include "cop0.h"
 #include "system.h"
+#include "memory.h"
 
 #define TLB_GLOBAL          (1 << 0) // If set, address space identifier is ignored and all processes can use this entry.
 #define TLB_VALID           (1 << 1) // If set, TLB (dual-)entry is valid and can be used. 
@@ -17,6 +18,14 @@
 #define PAGE_SIZE           (256 * 1024)
 #define USEG_VADDR          (0x00080000)
 #define USEG_PADDR          (0x00080000)
+// One TLB entry maps an even and an odd page.
+#define USEG_SIZE           (2 * PAGE_SIZE)
+
+// End of the user program, from the linker script.
+extern char __user_data_end[];
+
+/** @brief Next free address of the user segment, 0 until first used. */
+static uint32_t __user_region_next = 0;
 
 void tlb_init(void)
 {
@@ -30,3 +39,22 @@ void tlb_init(void)
     // Write TLB entry.
     C0_TLBWI();
 }
+
+void* user_region_alloc(uint32_t size)
+{
+    if (__user_region_next == 0)
+    {
+        __user_region_next = ((uint32_t) __user_data_end + 15) & ~15;
+    }
+
+    size = (size + 15) & ~15;
+    if ((size == 0) || (size > (USEG_VADDR + USEG_SIZE) - __user_region_next))
+    {
+        return NULL;
+    }
+
+    void* mem = (void*) __user_region_next;
+    __user_region_next += size;
+
+    return mem;
+}
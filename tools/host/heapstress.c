@@ -0,0 +1,455 @@
+/**
+ * @file heapstress.c
+ * @brief Fragmentation stress test of the kernel heap (kernel/src/malloc.c), run on the host.
+ *
+ * The kernel allocator is compiled into this program under different names, so it
+ * doesn't replace the host's own malloc. Its heap is mapped at the same offset as
+ * on a 4 MB console: the host register mocks leave addresses untouched, so the heap
+ * starts at 1 MB.
+ *
+ * Three phases run with a fixed random seed:
+ *   churn   - Random allocations from 16 bytes to 64 KB, freed in random order. Some
+ *             are aligned above 16 bytes or kept off the AI DMA boundary.
+ *   levels  - Repeated level loads: framebuffers and assets allocated around long
+ *             lived small allocations, then all freed again. Every load must fit.
+ *   drain   - Everything is freed, the heap must merge back into a single block.
+ *
+ * The contents of every allocation are checked before it's freed, and the heap
+ * structure is checked with malloc_get_stats throughout. The exit code is non-zero
+ * on any failure.
+ *
+ * With --bench, the heap is instead cut into thousands of free blocks and the time
+ * to find a block is compared between the TLSF size classes and a best-fit walk over
+ * a single list of all free blocks, which is how malloc searched before TLSF.
+ */
+
+#define malloc heap_malloc
+#define malloc_uncached heap_malloc_uncached
+#define free heap_free
+#include "../../kernel/src/malloc.c"
+#undef malloc
+#undef malloc_uncached
+#undef free
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#define SLOT_COUNT          (512)
+#define CHURN_STEPS         (200000)
+#define LEVEL_COUNT         (200)
+#define LEVEL_ASSETS        (48)
+#define CHECK_INTERVAL      (1000)
+#define BENCH_BLOCKS        (16384)
+#define BENCH_BATCH         (64)
+
+int __boot_memsize = 4 * ONE_MB;
+
+void print(const char* data)
+{
+    fputs(data, stdout);
+}
+
+void println(const char* data)
+{
+    puts(data);
+}
+
+uintptr_t host_kseg0(uintptr_t addr)
+{
+    return addr;
+}
+
+void data_cache_hit_writeback_invalidate(volatile void* addr, unsigned long length) {}
+void data_cache_range_writeback_invalidate(volatile void* addr, unsigned long length) {}
+
+void assert(bool condition, const char* msg)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "assertion failed: %s\n", msg);
+        fflush(NULL);
+        // abort() is the kernel's endless loop in this translation unit.
+        __builtin_trap();
+    }
+}
+
+/** @brief A live allocation and the pattern written into it. */
+typedef struct slot_s
+{
+    uint8_t* ptr;
+    uint32_t size;
+    uint8_t seed;
+} slot_t;
+
+static slot_t __slots[SLOT_COUNT];
+static uint32_t __random = 12345;
+static int __failures = 0;
+/** @brief Worst fragmentation seen, as the fraction of free memory not in the largest free block. */
+static float __worst_fragmentation = 0.0f;
+
+static uint32_t random_next(void)
+{
+    __random = __random * 1103515245 + 12345;
+    return __random >> 8;
+}
+
+/** @brief Random allocation size: mostly small objects, some sprites, a few big buffers. */
+static uint32_t random_size(void)
+{
+    uint32_t kind = random_next() % 100;
+    if (kind < 70)
+    {
+        return 1 + random_next() % 256;
+    }
+    if (kind < 95)
+    {
+        return 256 + random_next() % (8 * 1024);
+    }
+
+    return 8 * 1024 + random_next() % (56 * 1024);
+}
+
+static void fail(const char* what)
+{
+    printf("heapstress: %s\n", what);
+    __failures++;
+}
+
+static bool slot_alloc(slot_t* slot, uint32_t size)
+{
+    // Plain, uncached, aligned to 32 bytes up to 4 KB, and AI DMA buffers.
+    uint32_t kind = random_next() % 4;
+    uint32_t align = (kind == 2) ? (32 << (random_next() % 8)) : HEAP_ALIGN;
+    uint8_t* ptr;
+    switch (kind)
+    {
+        case 0: ptr = heap_malloc(size); break;
+        case 1: ptr = heap_malloc_uncached(size); break;
+        case 2: ptr = malloc_aligned(size, align); break;
+        default: ptr = malloc_dma(size, 8, 0x2000); break;
+    }
+    if (ptr == NULL)
+    {
+        return false;
+    }
+    if ((uintptr_t) ptr & (align - 1))
+    {
+        fail("allocation is not aligned");
+    }
+    if ((kind == 3) && ((((uintptr_t) ptr + size) & 0x1FFF) == 0))
+    {
+        fail("DMA buffer ends at the boundary");
+    }
+
+    slot->ptr = ptr;
+    slot->size = size;
+    slot->seed = random_next();
+    for (uint32_t i = 0; i < size; i++)
+    {
+        ptr[i] = slot->seed + i;
+    }
+
+    return true;
+}
+
+static void slot_free(slot_t* slot)
+{
+    for (uint32_t i = 0; i < slot->size; i++)
+    {
+        if (slot->ptr[i] != (uint8_t) (slot->seed + i))
+        {
+            fail("allocation was overwritten");
+            break;
+        }
+    }
+
+    heap_free(slot->ptr);
+    slot->ptr = NULL;
+}
+
+/** @brief Check the heap structure and track fragmentation. */
+static heap_stats_t check_heap(void)
+{
+    heap_stats_t stats;
+    if (!malloc_get_stats(&stats))
+    {
+        fail("heap is corrupted");
+    }
+    if (stats.used_bytes + stats.free_bytes != stats.total)
+    {
+        fail("heap blocks don't add up");
+    }
+
+    if (stats.free_bytes > 0)
+    {
+        float fragmentation = 1.0f - (float) stats.largest_free / stats.free_bytes;
+        if (fragmentation > __worst_fragmentation)
+        {
+            __worst_fragmentation = fragmentation;
+        }
+    }
+
+    return stats;
+}
+
+static void phase_churn(void)
+{
+    int failed_allocs = 0;
+    for (int step = 0; step < CHURN_STEPS; step++)
+    {
+        slot_t* slot = &__slots[random_next() % SLOT_COUNT];
+        if (slot->ptr != NULL)
+        {
+            slot_free(slot);
+        }
+        else if (!slot_alloc(slot, random_size()))
+        {
+            failed_allocs++;
+        }
+
+        if (step % CHECK_INTERVAL == 0)
+        {
+            check_heap();
+        }
+    }
+
+    heap_stats_t stats = check_heap();
+    printf("churn:  %d steps, %d allocations didn't fit, %u used blocks, %u free blocks, largest free %u bytes\n",
+           CHURN_STEPS, failed_allocs, stats.used_blocks, stats.free_blocks, stats.largest_free);
+}
+
+static void phase_levels(void)
+{
+    // Long lived allocations are the first quarter of the slots, level data the rest.
+    for (int i = SLOT_COUNT / 4; i < SLOT_COUNT; i++)
+    {
+        if (__slots[i].ptr != NULL)
+        {
+            slot_free(&__slots[i]);
+        }
+    }
+    for (int i = 0; i < SLOT_COUNT / 4; i++)
+    {
+        if (__slots[i].ptr == NULL)
+        {
+            slot_alloc(&__slots[i], 1 + random_next() % 512);
+        }
+    }
+
+    int failed_loads = 0;
+    for (int level = 0; level < LEVEL_COUNT; level++)
+    {
+        // Three 320x240 RGBA16 framebuffers, then the level's assets.
+        bool loaded = true;
+        int next = SLOT_COUNT / 4;
+        for (int i = 0; i < 3; i++)
+        {
+            loaded &= slot_alloc(&__slots[next++], 320 * 240 * 2);
+        }
+        for (int i = 0; i < LEVEL_ASSETS; i++)
+        {
+            loaded &= slot_alloc(&__slots[next++], 64 + random_next() % (8 * 1024));
+        }
+        if (!loaded)
+        {
+            failed_loads++;
+        }
+
+        // Some long lived allocations come and go while the level runs.
+        for (int i = 0; i < 16; i++)
+        {
+            slot_t* slot = &__slots[random_next() % (SLOT_COUNT / 4)];
+            if (slot->ptr != NULL)
+            {
+                slot_free(slot);
+            }
+            slot_alloc(slot, 1 + random_next() % 512);
+        }
+
+        check_heap();
+
+        for (int i = SLOT_COUNT / 4; i < next; i++)
+        {
+            if (__slots[i].ptr != NULL)
+            {
+                slot_free(&__slots[i]);
+            }
+        }
+    }
+
+    if (failed_loads)
+    {
+        fail("level didn't fit into the heap");
+    }
+
+    heap_stats_t stats = check_heap();
+    printf("levels: %d loads, %d didn't fit, %u free blocks, largest free %u bytes\n",
+           LEVEL_COUNT, failed_loads, stats.free_blocks, stats.largest_free);
+}
+
+static void phase_drain(void)
+{
+    for (int i = 0; i < SLOT_COUNT; i++)
+    {
+        if (__slots[i].ptr != NULL)
+        {
+            slot_free(&__slots[i]);
+        }
+    }
+
+    heap_stats_t stats = check_heap();
+    if ((stats.used_blocks != 0) || (stats.free_blocks != 1) || (stats.largest_free != stats.total - sizeof(block_info_t)))
+    {
+        fail("heap didn't merge back into a single block");
+    }
+
+    printf("drain:  %u used blocks, %u free blocks, largest free %u of %u bytes\n",
+           stats.used_blocks, stats.free_blocks, stats.largest_free, stats.total);
+}
+
+/** @brief Free list node of the list walk, kept in the payload of a free block. */
+typedef struct list_node_s
+{
+    struct list_node_s* next;
+    uint32_t size;
+} list_node_t;
+
+/** @brief Best fit over a list of all free blocks, the search malloc did before TLSF. */
+static block_info_t* list_find(list_node_t* head, uint32_t size)
+{
+    list_node_t* best = NULL;
+    for (list_node_t* node = head; node != NULL; node = node->next)
+    {
+        if ((node->size >= size) && ((best == NULL) || (node->size < best->size)))
+        {
+            best = node;
+            if (node->size == size)
+            {
+                break;
+            }
+        }
+    }
+
+    return (best != NULL) ? (block_info_t*) best - 1 : NULL;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/** @brief Time a search, the fastest of a few batches to keep host scheduling noise out. */
+static uint64_t time_search(list_node_t* head, uint32_t size, bool tlsf, block_info_t** found)
+{
+    uint64_t best = ~0ULL;
+    for (int run = 0; run < 16; run++)
+    {
+        uint64_t start = now_ns();
+        for (int i = 0; i < BENCH_BATCH; i++)
+        {
+            *found = tlsf ? free_list_find(size) : list_find(head, size);
+            // Keep the compiler from hoisting the search out of the loop.
+            __asm__ volatile("" ::: "memory");
+        }
+        uint64_t elapsed = (now_ns() - start) / BENCH_BATCH;
+        if (elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+    return best;
+}
+
+static void run_benchmark(void)
+{
+    // Fill most of the heap with small blocks and free every other one, leaving
+    // a long history of holes and one big free block at the end.
+    static void* ptrs[BENCH_BLOCKS];
+    for (int i = 0; i < BENCH_BLOCKS; i++)
+    {
+        ptrs[i] = heap_malloc(16 + (random_next() % 4) * 16);
+    }
+    for (int i = 1; i < BENCH_BLOCKS; i += 2)
+    {
+        heap_free(ptrs[i]);
+    }
+
+    // Thread the same free blocks into a single list for the list walk.
+    list_node_t* head = NULL;
+    for (block_info_t* block = __heap_start; block < __heap_end; block = block_next(block))
+    {
+        if (!(block->size & BLOCK_USED))
+        {
+            list_node_t* node = (list_node_t*) (block + 1);
+            node->size = block->size;
+            node->next = head;
+            head = node;
+        }
+    }
+
+    heap_stats_t stats = check_heap();
+    printf("bench: %u free blocks, %u used blocks\n", stats.free_blocks, stats.used_blocks);
+    printf("bench: %10s %12s %12s\n", "block size", "TLSF ns", "list ns");
+
+    static const uint32_t sizes[] = {32, 48, 80, 256, 1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024};
+    uint64_t worst_tlsf = 0;
+    uint64_t worst_list = 0;
+    for (int i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        block_info_t* tlsf_block;
+        block_info_t* list_block;
+        uint64_t tlsf = time_search(head, sizes[i], true, &tlsf_block);
+        uint64_t list = time_search(head, sizes[i], false, &list_block);
+        if ((tlsf_block == NULL) != (list_block == NULL))
+        {
+            fail("TLSF and the list walk disagree whether a block fits");
+        }
+
+        printf("bench: %10u %12llu %12llu\n", sizes[i], (unsigned long long) tlsf, (unsigned long long) list);
+        worst_tlsf = (tlsf > worst_tlsf) ? tlsf : worst_tlsf;
+        worst_list = (list > worst_list) ? list : worst_list;
+    }
+
+    printf("bench: worst case %llu ns with TLSF, %llu ns with the list walk\n",
+           (unsigned long long) worst_tlsf, (unsigned long long) worst_list);
+}
+
+int main(int argc, char* argv[])
+{
+    void* heap = mmap((void*) KERNEL_HEAP_START, KERNEL_HEAP_END - KERNEL_HEAP_START, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (heap != (void*) KERNEL_HEAP_START)
+    {
+        fprintf(stderr, "Cannot map the heap at 0x%lx\n", (unsigned long) KERNEL_HEAP_START);
+        return 1;
+    }
+
+    malloc_init();
+    check_heap();
+
+    if ((heap_malloc(0) != NULL) || (heap_malloc(KERNEL_HEAP_END) != NULL))
+    {
+        fail("impossible allocation succeeded");
+    }
+    heap_free(NULL);
+
+    if ((argc > 1) && (strcmp(argv[1], "--bench") == 0))
+    {
+        run_benchmark();
+        return __failures ? 1 : 0;
+    }
+
+    phase_churn();
+    phase_levels();
+    phase_drain();
+
+    printf("heapstress: worst fragmentation %.1f%%, %s\n", __worst_fragmentation * 100.0f,
+           __failures ? "FAILED" : "passed");
+
+    return __failures ? 1 : 0;
+}
@@ -0,0 +1,1052 @@
+/**
+ * @file hostgfx.c
+ * @brief Host build of the KIVOS64 graphics code, with golden image checks and blit benchmarks.
+ *
+ * graphics.c, display.c, primitives.c, tilemap.c and lz4.c are compiled for the host
+ * as they are, on top of the register-mock layer in mock.c. Every draw call takes
+ * the CPU path, which is the one optimization work on the blitters touches.
+ *
+ * Usage:
+ *   hostgfx --out DIR       Render the reference scenes into DIR as PPM files.
+ *   hostgfx --golden DIR    Compare the reference scenes against the PPM files in DIR.
+ *   hostgfx --bench         Time fills and blits on a 320x240 surface, and LZ4 decompression.
+ *
+ * The options can be combined. Each scene is rendered into an RGBA16 and an RGBA32
+ * surface. With both --golden and --out, only scenes that don't match are written.
+ * The exit code is non-zero if a scene doesn't match or any of the checks fail
+ * (colors, uncached access, LZ4 round trips, display buffers, RDP surface fences).
+ *
+ * After an intended change to the output, refresh the golden images with
+ * "hostgfx --out host/golden" and check the differences by eye.
+ */
+
+#include "graphics.h"
+#include "system.h"
+#include "primitives.h"
+#include "tilemap.h"
+#include "arena.h"
+#include "lz4.h"
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SCENE_WIDTH     (96)
+#define SCENE_HEIGHT    (64)
+
+#define BENCH_WIDTH     (320)
+#define BENCH_HEIGHT    (240)
+#define BENCH_SECONDS   (0.25)
+
+/** @brief Test assets, generated at startup so that they come out the same on every host. */
+static surface_t __sprite;
+static surface_t __sprite16;
+static surface_t __sprite_ci8;
+static surface_t __sprite_ci4;
+static surface_t __tileset;
+static uint32_t __palette8[256];
+static uint32_t __palette4[16];
+
+/** @brief RGBA32 sprite with color gradients, an alpha ramp and a fully transparent border. */
+static surface_t make_sprite(int width, int height, surface_format_t format)
+{
+    surface_t sprite = surface_alloc(width, height, format);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            bool border = (x == 0) || (y == 0) || (x == width - 1) || (y == height - 1);
+            uint8_t r = x * 255 / width;
+            uint8_t g = y * 255 / height;
+            uint8_t b = 255 - ((x + y) * 4);
+            uint8_t a = border ? 0 : 64 + x * 191 / width;
+            if (format == FMT_RGBA16)
+            {
+                ((uint16_t*) sprite.buffer)[x + y * width] = RGBA16(r, g, b, a);
+            }
+            else
+            {
+                ((uint32_t*) sprite.buffer)[x + y * width] = RGBA32(r, g, b, a);
+            }
+        }
+    }
+
+    return sprite;
+}
+
+/** @brief Color-indexed sprite of concentric rings, palette index 0 is transparent. */
+static surface_t make_sprite_ci(int width, int height, surface_format_t format, uint32_t* palette, int colors)
+{
+    surface_t sprite = surface_alloc(width, height, format);
+    sprite.palette = palette;
+
+    palette[0] = RGBA32(0, 0, 0, 0);
+    for (int i = 1; i < colors; i++)
+    {
+        palette[i] = RGBA32(i * 255 / colors, 255 - i * 255 / colors, (i * 97) & 0xFF, 128 + i * 127 / colors);
+    }
+
+    uint8_t* indices = sprite.buffer;
+    memset(indices, 0, surface_buffer_size(format, width, height));
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int dx = 2 * x - width;
+            int dy = 2 * y - height;
+            int index = ((dx * dx + dy * dy) / 16) % colors;
+            if (format == FMT_CI8)
+            {
+                indices[x + y * width] = index;
+            }
+            else
+            {
+                int i = x + y * width;
+                indices[i / 2] |= (i & 1) ? index : (index << 4);
+            }
+        }
+    }
+
+    return sprite;
+}
+
+/** @brief Tileset of four 8x8 tiles stacked vertically. */
+static surface_t make_tileset(void)
+{
+    surface_t tileset = surface_alloc(8, 32, FMT_RGBA32);
+    for (int y = 0; y < 32; y++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            int tile = y / 8;
+            bool edge = (x == 0) || ((y % 8) == 0);
+            ((uint32_t*) tileset.buffer)[x + y * 8] = edge ? RGBA32(32, 32, 32, 255) : RGBA32(64 * tile, 255 - 64 * tile, 128, 255);
+        }
+    }
+
+    return tileset;
+}
+
+/** @brief Fill the surface with a checkerboard, so that blending shows. */
+static void draw_checkerboard(surface_t* dst)
+{
+    graphics_fill(dst, RGBA32(40, 40, 60, 255));
+    for (int y = 0; y < dst->height; y += 8)
+    {
+        for (int x = (y / 8) % 2 * 8; x < dst->width; x += 16)
+        {
+            graphics_fill_rect(dst, x, y, 8, 8, RGBA32(200, 200, 180, 255));
+        }
+    }
+}
+
+static void scene_fill(surface_t* dst)
+{
+    graphics_fill(dst, RGBA32(0, 0, 64, 255));
+    // Every start alignment and run length up to a few 64-bit stores.
+    for (int i = 0; i < 8; i++)
+    {
+        graphics_fill_rect(dst, 1 + i * 11 + i % 4, 2 + i * 3, 1 + i * 3, 5, RGBA32(255, 32 * i, 0, 255));
+    }
+    graphics_fill_rect(dst, -10, 30, 30, 10, RGBA32(0, 255, 0, 255));
+    graphics_fill_rect(dst, 80, 50, 40, 40, RGBA32(255, 255, 255, 255));
+    graphics_fill_rect(dst, 30, -5, 7, 60, RGBA32(255, 0, 255, 255));
+    for (int x = 0; x < SCENE_WIDTH; x += 3)
+    {
+        graphics_draw_pixel(dst, x, 45 + x % 7, RGBA32(255, 255, 0, 255));
+        graphics_draw_pixel_alpha(dst, x, 55 - x % 5, RGBA32(0, 255, 255, 128));
+    }
+    graphics_fill_span(dst, 5, 90, 60, RGBA32(255, 128, 0, 255));
+    graphics_blend_span(dst, 3, 77, 58, RGBA32(0, 0, 255, 100));
+}
+
+static void scene_blit(surface_t* dst)
+{
+    draw_checkerboard(dst);
+    graphics_draw_surface(dst, 3, 5, &__sprite);
+    graphics_draw_surface(dst, 40, 6, &__sprite16);
+    graphics_draw_surface(dst, -7, 40, &__sprite);
+    graphics_draw_surface(dst, 80, -3, &__sprite16);
+    graphics_draw_surface(dst, 60, 40, &__sprite_ci8);
+}
+
+static void scene_alpha(surface_t* dst)
+{
+    draw_checkerboard(dst);
+    graphics_draw_surface_alpha(dst, 2, 2, &__sprite);
+    graphics_draw_surface_alpha(dst, 37, 3, &__sprite16);
+    graphics_draw_surface_alpha(dst, 75, 45, &__sprite);
+    graphics_draw_surface_region_alpha(dst, 4, 38, &__sprite, 8, 4, 14, 18);
+
+    surface_t premultiplied = make_sprite(__sprite.width, __sprite.height, FMT_RGBA32);
+    surface_premultiply(&premultiplied);
+    graphics_draw_surface_alpha(dst, 40, 36, &premultiplied);
+    free(premultiplied.buffer);
+}
+
+static void scene_transform(surface_t* dst)
+{
+    draw_checkerboard(dst);
+
+    // Flips mirror around the pivot, keep it in the middle so the sprite stays in place.
+    blit_params_t params = {.pivot_x = 12, .pivot_y = 12, .scale_x = 1.0f, .scale_y = 1.0f, .flags = BLIT_FLIP_X};
+    graphics_draw_surface_transformed(dst, 14, 14, &__sprite, &params);
+
+    params = (blit_params_t) {.pivot_x = 12, .pivot_y = 12, .scale_x = 2.0f, .scale_y = 1.5f, .flags = BLIT_FLIP_Y};
+    graphics_draw_surface_transformed(dst, 55, 20, &__sprite, &params);
+
+    params = (blit_params_t) {.scale_x = 0.5f, .scale_y = 0.5f};
+    graphics_draw_surface_transformed(dst, 2, 40, &__sprite16, &params);
+
+    params = (blit_params_t) {.pivot_x = 12, .pivot_y = 12, .scale_x = 1.25f, .scale_y = 1.25f, .angle = 0.5236f};
+    graphics_draw_surface_transformed(dst, 75, 44, &__sprite, &params);
+
+    params = (blit_params_t) {.src_x = 4, .src_y = 4, .width = 16, .height = 8, .scale_x = -1.0f, .scale_y = 2.0f, .angle = -1.0f};
+    graphics_draw_surface_transformed(dst, 30, 50, &__sprite_ci4, &params);
+}
+
+static void scene_palette(surface_t* dst)
+{
+    draw_checkerboard(dst);
+    graphics_draw_surface(dst, 2, 2, &__sprite_ci8);
+    graphics_draw_surface(dst, 31, 3, &__sprite_ci4);
+    graphics_draw_surface_alpha(dst, 2, 33, &__sprite_ci8);
+    graphics_draw_surface_alpha(dst, 33, 34, &__sprite_ci4);
+    graphics_draw_surface_region_alpha(dst, 70, 20, &__sprite_ci4, 5, 3, 21, 19);
+}
+
+static void scene_primitives(surface_t* dst)
+{
+    graphics_fill(dst, RGBA32(16, 16, 16, 255));
+    for (int i = 0; i < 8; i++)
+    {
+        graphics_draw_line(dst, 48, 32, i * 16 - 10, (i % 2) ? -5 : 70, RGBA32(255, i * 32, 64, 255));
+    }
+    graphics_draw_line_alpha(dst, 0, 0, 95, 63, RGBA32(255, 255, 255, 128));
+    graphics_draw_rect(dst, 4, 4, 30, 20, RGBA32(0, 255, 0, 255));
+    graphics_draw_rect_alpha(dst, 70, 40, 40, 40, RGBA32(0, 255, 255, 160));
+    graphics_fill_rect_alpha(dst, 10, 30, 40, 25, RGBA32(255, 0, 0, 96));
+    graphics_draw_circle(dst, 70, 20, 15, RGBA32(255, 255, 0, 255));
+    graphics_fill_circle(dst, 20, 50, 10, RGBA32(0, 128, 255, 255));
+    graphics_draw_circle_alpha(dst, 90, 60, 20, RGBA32(255, 0, 255, 200));
+    graphics_fill_circle_alpha(dst, 50, 30, 12, RGBA32(255, 255, 255, 80));
+}
+
+static void scene_text(surface_t* dst)
+{
+    draw_checkerboard(dst);
+    graphics_draw_text(dst, 2, 2, "KIVOS64", RGBA32(255, 255, 255, 255));
+    graphics_draw_text(dst, 2, 12, "0123456789", RGBA32(255, 255, 0, 255));
+    graphics_draw_text(dst, 2, 22, "!\"#$%&'()*+,-./:", RGBA32(0, 255, 0, 255));
+    graphics_draw_text(dst, -3, 32, "clipped text", RGBA32(255, 0, 0, 255));
+    graphics_draw_text(dst, 5, 43, "line one\nline two", RGBA32(0, 0, 0, 160));
+    graphics_draw_text(dst, 60, 60, "edge", RGBA32(0, 255, 255, 255));
+}
+
+static void scene_tilemap(surface_t* dst)
+{
+    static const uint16_t tiles[6 * 4] = {
+        0, 1, 2, 3, 0, 1,
+        1, TILEMAP_EMPTY, 3, 0, 1, 2,
+        2, 3, 0, TILEMAP_EMPTY, 2, 3,
+        3, 0, 1, 2, 3, 0
+    };
+
+    graphics_fill(dst, RGBA32(0, 0, 0, 255));
+    tilemap_t map = {
+        .tileset = &__tileset,
+        .tiles = tiles,
+        .tile_width = 8,
+        .tile_height = 8,
+        .width = 6,
+        .height = 4,
+        .scroll_x = -5,
+        .scroll_y = 13,
+        .x = 3,
+        .y = 2,
+        .view_width = 90,
+        .view_height = 40
+    };
+    tilemap_draw(dst, &map);
+
+    map.scroll_x = 100;
+    map.scroll_y = -3;
+    map.x = -4;
+    map.y = 44;
+    map.view_height = 30;
+    tilemap_draw(dst, &map);
+}
+
+typedef struct scene_s
+{
+    const char* name;
+    void (*draw)(surface_t* dst);
+} scene_t;
+
+static const scene_t __scenes[] = {
+    {"fill", scene_fill},
+    {"blit", scene_blit},
+    {"alpha", scene_alpha},
+    {"transform", scene_transform},
+    {"palette", scene_palette},
+    {"primitives", scene_primitives},
+    {"text", scene_text},
+    {"tilemap", scene_tilemap},
+};
+
+#define SCENE_COUNT     ((int) (sizeof(__scenes) / sizeof(__scenes[0])))
+
+/** @brief Convert a surface into a binary PPM image, alpha is dropped. */
+static uint8_t* surface_to_ppm(surface_t* surface, size_t* size)
+{
+    char header[32];
+    int header_size = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", surface->width, surface->height);
+    *size = header_size + surface->width * surface->height * 3;
+
+    uint8_t* ppm = malloc(*size);
+    memcpy(ppm, header, header_size);
+
+    uint8_t* rgb = ppm + header_size;
+    for (int i = 0; i < surface->width * surface->height; i++)
+    {
+        if (surface->format == FMT_RGBA16)
+        {
+            uint16_t color = ((uint16_t*) surface->buffer)[i];
+            // Replicate the top bits into the bottom ones, like the VI does.
+            uint8_t r = (color >> 11) & 0x1F;
+            uint8_t g = (color >> 6) & 0x1F;
+            uint8_t b = (color >> 1) & 0x1F;
+            *rgb++ = (r << 3) | (r >> 2);
+            *rgb++ = (g << 3) | (g >> 2);
+            *rgb++ = (b << 3) | (b >> 2);
+        }
+        else
+        {
+            uint32_t color = ((uint32_t*) surface->buffer)[i];
+            *rgb++ = color >> 24;
+            *rgb++ = color >> 16;
+            *rgb++ = color >> 8;
+        }
+    }
+
+    return ppm;
+}
+
+static bool write_file(const char* path, const uint8_t* data, size_t size)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, file) == size;
+    fclose(file);
+
+    return ok;
+}
+
+/** @brief Read a whole file, returns NULL if it can't be read. */
+static uint8_t* read_file(const char* path, size_t* size)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t* data = malloc(length > 0 ? length : 1);
+    *size = fread(data, 1, length, file);
+    fclose(file);
+
+    return data;
+}
+
+/** @brief Count the pixels that differ between two PPM images of the same header. */
+static int ppm_mismatches(const uint8_t* a, size_t a_size, const uint8_t* b, size_t b_size, size_t header_size)
+{
+    if ((a_size != b_size) || memcmp(a, b, header_size))
+    {
+        return -1;
+    }
+
+    int count = 0;
+    for (size_t i = header_size; i < a_size; i += 3)
+    {
+        if (memcmp(a + i, b + i, 3))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/** @brief Render all scenes, write and compare them as requested. Returns the number of failures. */
+static int run_scenes(const char* out_dir, const char* golden_dir)
+{
+    static const surface_format_t formats[] = {FMT_RGBA16, FMT_RGBA32};
+    static const char* format_names[] = {"rgba16", "rgba32"};
+
+    int failures = 0;
+    for (int s = 0; s < SCENE_COUNT; s++)
+    {
+        for (int f = 0; f < 2; f++)
+        {
+            char name[64];
+            char path[512];
+            snprintf(name, sizeof(name), "%s_%s.ppm", __scenes[s].name, format_names[f]);
+
+            surface_t surface = surface_alloc(SCENE_WIDTH, SCENE_HEIGHT, formats[f]);
+            __scenes[s].draw(&surface);
+
+            size_t size;
+            uint8_t* ppm = surface_to_ppm(&surface, &size);
+            bool matches = true;
+
+            if (golden_dir != NULL)
+            {
+                size_t golden_size;
+                snprintf(path, sizeof(path), "%s/%s", golden_dir, name);
+                uint8_t* golden = read_file(path, &golden_size);
+                if (golden == NULL)
+                {
+                    printf("%-24s missing golden image\n", name);
+                    matches = false;
+                }
+                else
+                {
+                    int mismatches = ppm_mismatches(ppm, size, golden, golden_size, size - SCENE_WIDTH * SCENE_HEIGHT * 3);
+                    if (mismatches != 0)
+                    {
+                        if (mismatches < 0)
+                        {
+                            printf("%-24s size differs from golden image\n", name);
+                        }
+                        else
+                        {
+                            printf("%-24s %d pixels differ from golden image\n", name, mismatches);
+                        }
+                        matches = false;
+                    }
+                    free(golden);
+                }
+
+                if (!matches)
+                {
+                    failures++;
+                }
+            }
+
+            if ((out_dir != NULL) && ((golden_dir == NULL) || !matches))
+            {
+                snprintf(path, sizeof(path), "%s/%s", out_dir, name);
+                if (!write_file(path, ppm, size))
+                {
+                    failures++;
+                }
+            }
+
+            free(ppm);
+            free(surface.buffer);
+        }
+    }
+
+    if (golden_dir != NULL)
+    {
+        printf("scenes: %d of %d images match\n", 2 * SCENE_COUNT - failures, 2 * SCENE_COUNT);
+    }
+
+    return failures;
+}
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("check failed: %s (line %d)\n", #condition, __LINE__); \
+            failures++; \
+        } \
+    } while (0)
+
+/** @brief Check the color macros with expressions as arguments, the way the RDP fill converts its color. */
+static int check_colors(void)
+{
+    int failures = 0;
+
+    uint32_t color = 0xFF8040FF;
+    CHECK(RGBA16(color >> 24, color >> 16, color >> 8, color) == 0xFC11);
+    CHECK(RGBA16(color >> 24, color >> 16, color >> 8, color) == color_to_rgba16(color));
+    CHECK(RGBA32(color >> 24, color >> 16, color >> 8, color) == color);
+    CHECK(RGBA32(0x100 | 0x12, 0x34, 0x56, 0x78) == 0x12345678);
+
+    printf("colors: %s\n", failures ? "checks failed" : "checks passed");
+
+    return failures;
+}
+
+/**
+ * @brief Check that the CPU blit paths read uncached sprites through their own pointer.
+ *
+ * Debug builds of the kernel assert on freeing uncached memory that has lines in
+ * the data cache, which the mock layer stands in for by recording KSEG0 accesses.
+ */
+static int check_uncached(void)
+{
+    int failures = 0;
+
+    surface_t dst = surface_alloc(64, 48, FMT_RGBA32);
+    surface_t sprite = make_sprite(24, 24, FMT_RGBA32);
+    uint32_t size = surface_buffer_size(sprite.format, sprite.width, sprite.height);
+
+    graphics_fill(&dst, RGBA32(0, 0, 0, 255));
+    graphics_draw_surface_region_alpha(&dst, 4, 4, &sprite, 2, 2, 16, 16);
+    blit_params_t params = {.pivot_x = 12, .pivot_y = 12, .scale_x = 1.5f, .scale_y = 1.5f, .angle = 0.3f};
+    graphics_draw_surface_transformed(&dst, 32, 24, &sprite, &params);
+
+    static const uint16_t tiles[] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+    tilemap_t map = {
+        .tileset = &sprite,
+        .tiles = tiles,
+        .tile_width = 8,
+        .tile_height = 8,
+        .width = 3,
+        .height = 3,
+        .view_width = 64,
+        .view_height = 48
+    };
+    tilemap_draw(&dst, &map);
+
+    CHECK(!data_cache_range_resident(sprite.buffer, size));
+    surface_free(sprite);
+    surface_free(dst);
+
+    printf("uncached: %s\n", failures ? "checks failed" : "checks passed");
+
+    return failures;
+}
+
+/** @brief Check that source regions and tiles reaching outside the source are clipped to it. */
+static int check_regions(void)
+{
+    int failures = 0;
+
+    surface_t expected = surface_alloc(48, 48, FMT_RGBA32);
+    surface_t actual = surface_alloc(48, 48, FMT_RGBA32);
+    uint32_t size = surface_buffer_size(expected.format, expected.width, expected.height);
+
+    graphics_fill(&expected, RGBA32(0, 0, 0, 255));
+    graphics_draw_surface_region_alpha(&expected, 8, 6, &__sprite, 0, 2, 24, 22);
+    graphics_fill(&actual, RGBA32(0, 0, 0, 255));
+    graphics_draw_surface_region_alpha(&actual, 4, 6, &__sprite, -4, 2, 100, 100);
+    CHECK(memcmp(expected.buffer, actual.buffer, size) == 0);
+
+    blit_params_t params = {.src_x = 8, .src_y = 4, .width = 16, .height = 20, .scale_x = 1.0f, .scale_y = 1.0f};
+    graphics_fill(&expected, RGBA32(0, 0, 0, 255));
+    graphics_draw_surface_transformed(&expected, 10, 10, &__sprite, &params);
+    params.width = 0;
+    params.height = 200;
+    graphics_fill(&actual, RGBA32(0, 0, 0, 255));
+    graphics_draw_surface_transformed(&actual, 10, 10, &__sprite, &params);
+    CHECK(memcmp(expected.buffer, actual.buffer, size) == 0);
+
+    // Regions starting outside of the source draw nothing.
+    graphics_fill(&expected, RGBA32(0, 0, 0, 255));
+    memcpy(actual.buffer, expected.buffer, size);
+    params.src_x = __sprite.width;
+    graphics_draw_surface_transformed(&actual, 10, 10, &__sprite, &params);
+    graphics_draw_surface_region_alpha(&actual, 0, 0, &__sprite, __sprite.width, 0, 8, 8);
+    CHECK(memcmp(expected.buffer, actual.buffer, size) == 0);
+
+    // Tile indices past the tileset are left empty, and tiles wider than the tileset draw nothing.
+    static const uint16_t tiles[] = {0, TILEMAP_EMPTY, 2, TILEMAP_EMPTY};
+    static const uint16_t tiles_past_end[] = {0, 4, 2, 1000};
+    tilemap_t map = {
+        .tileset = &__sprite,
+        .tiles = tiles,
+        .tile_width = 12,
+        .tile_height = 12,
+        .width = 2,
+        .height = 2,
+        .view_width = 48,
+        .view_height = 48
+    };
+    graphics_fill(&expected, RGBA32(0, 0, 0, 255));
+    tilemap_draw(&expected, &map);
+    graphics_fill(&actual, RGBA32(0, 0, 0, 255));
+    map.tiles = tiles_past_end;
+    tilemap_draw(&actual, &map);
+    CHECK(memcmp(expected.buffer, actual.buffer, size) == 0);
+
+    graphics_fill(&expected, RGBA32(0, 0, 0, 255));
+    memcpy(actual.buffer, expected.buffer, size);
+    map.tile_width = __sprite.width + 1;
+    tilemap_draw(&actual, &map);
+    CHECK(memcmp(expected.buffer, actual.buffer, size) == 0);
+
+    surface_free(expected);
+    surface_free(actual);
+
+    printf("regions: %s\n", failures ? "checks failed" : "checks passed");
+
+    return failures;
+}
+
+/** @brief How far back #lz4_compress_test looks for matches. */
+#define LZ4_TEST_WINDOW     (256)
+
+/** @brief Match offsets below 4 used by #lz4_compress_test, bit n for offset n. */
+static uint32_t __lz4_short_offsets;
+
+/** @brief Append the extension bytes of a length whose nibble is 15. */
+static uint8_t* lz4_put_length(uint8_t* out, uint32_t length)
+{
+    while (length >= 255)
+    {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = length;
+
+    return out;
+}
+
+/** @brief Append a sequence, without a match if length is 0. */
+static uint8_t* lz4_put_sequence(uint8_t* out, const uint8_t* literals, uint32_t literal_length, uint32_t offset, uint32_t length)
+{
+    uint32_t match_code = length ? (length - 4) : 0;
+    *out++ = ((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15);
+    if (literal_length >= 15)
+    {
+        out = lz4_put_length(out, literal_length - 15);
+    }
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+
+    if (length)
+    {
+        *out++ = offset & 0xFF;
+        *out++ = offset >> 8;
+        if (match_code >= 15)
+        {
+            out = lz4_put_length(out, match_code - 15);
+        }
+    }
+
+    return out;
+}
+
+/**
+ * @brief Compress into a blob, padded to 4 bytes.
+ *
+ * Independent of the encoder in spriteconv. The search tries every offset in the
+ * window and takes the shortest of the longest matches, so runs of a repeated byte
+ * pattern shorter than a word come out as the overlapping matches the decompressor
+ * seeds byte by byte. The output follows the LZ4 end of block rules.
+ *
+ * @return Size of the blob in bytes.
+ */
+static uint32_t lz4_compress_test(uint8_t* blob, const uint8_t* src, uint32_t size)
+{
+    lz4_blob_t* header = (lz4_blob_t*) blob;
+    header->magic = LZ4_MAGIC;
+    header->size = size;
+    uint8_t* out = header->data;
+
+    uint32_t literal_start = 0;
+    uint32_t pos = 0;
+    // The last match starts at least 12 bytes before the end and the last 5 bytes are literals.
+    while (pos + 12 <= size)
+    {
+        uint32_t best_length = 0;
+        uint32_t best_offset = 0;
+        for (uint32_t offset = 1; (offset <= pos) && (offset <= LZ4_TEST_WINDOW); offset++)
+        {
+            uint32_t length = 0;
+            while ((pos + length < size - 5) && (src[pos + length] == src[pos + length - offset]))
+            {
+                length++;
+            }
+            if (length > best_length)
+            {
+                best_length = length;
+                best_offset = offset;
+            }
+        }
+
+        if (best_length < 4)
+        {
+            pos++;
+            continue;
+        }
+
+        if (best_offset < 4)
+        {
+            __lz4_short_offsets |= 1 << best_offset;
+        }
+        out = lz4_put_sequence(out, src + literal_start, pos - literal_start, best_offset, best_length);
+        pos += best_length;
+        literal_start = pos;
+    }
+    out = lz4_put_sequence(out, src + literal_start, size - literal_start, 0, 0);
+
+    while ((out - blob) & 3)
+    {
+        *out++ = 0;
+    }
+
+    return out - blob;
+}
+
+/** @brief Compress and decompress data, and check that it comes back unchanged. */
+static bool lz4_round_trip(const uint8_t* src, uint32_t size)
+{
+    uint8_t* blob = malloc(sizeof(lz4_blob_t) + size + size / 255 + 16);
+    uint8_t* dst = malloc(size + 1);
+    uint32_t blob_size = lz4_compress_test(blob, src, size);
+
+    dst[size] = 0xA5;
+    bool ok = (lz4_decompressed_size(blob) == size) &&
+              (lz4_decompress(dst, size, blob, blob_size) == (int) size) &&
+              (memcmp(dst, src, size) == 0) &&
+              (dst[size] == 0xA5) &&
+              // Too small a buffer and a truncated blob must both be rejected.
+              (lz4_decompress(dst, size - 1, blob, blob_size) == -1) &&
+              (lz4_decompress(dst, size, blob, blob_size - 5) == -1);
+
+    free(blob);
+    free(dst);
+
+    return ok;
+}
+
+/** @brief Check LZ4 round trips through the kernel decompressor, overlapping matches included. */
+static int check_lz4(void)
+{
+    int failures = 0;
+
+    // Runs repeating 1, 2 and 3 byte patterns, of lengths around the seed sizes and
+    // the 15 nibble, each after a few literals.
+    uint8_t runs[4096];
+    uint32_t size = 0;
+    static const uint32_t lengths[] = {4, 5, 6, 7, 8, 9, 13, 18, 19, 20, 33, 270, 600};
+    for (uint32_t period = 1; period <= 3; period++)
+    {
+        for (int i = 0; i < (int) (sizeof(lengths) / sizeof(lengths[0])); i++)
+        {
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                runs[size++] = 0xF0 + i + j;
+            }
+            for (uint32_t j = 0; j < period + lengths[i]; j++)
+            {
+                runs[size++] = 0x10 * period + (j % period);
+            }
+        }
+    }
+    __lz4_short_offsets = 0;
+    CHECK(lz4_round_trip(runs, size));
+    CHECK(__lz4_short_offsets == ((1 << 1) | (1 << 2) | (1 << 3)));
+
+    // Incompressible data has literal runs long enough for several extension bytes.
+    uint8_t noise[700];
+    uint32_t random = 1;
+    for (int i = 0; i < (int) sizeof(noise); i++)
+    {
+        random = random * 1103515245 + 12345;
+        noise[i] = random >> 16;
+    }
+    CHECK(lz4_round_trip(noise, sizeof(noise)));
+    CHECK(lz4_round_trip(noise, 13));
+
+    CHECK(lz4_round_trip(__sprite.buffer, surface_buffer_size(__sprite.format, __sprite.width, __sprite.height)));
+    CHECK(lz4_round_trip(__sprite_ci4.buffer, surface_buffer_size(__sprite_ci4.format, __sprite_ci4.width, __sprite_ci4.height)));
+
+    // The same through a surface.
+    uint32_t sprite_size = surface_buffer_size(__sprite16.format, __sprite16.width, __sprite16.height);
+    uint8_t* blob = malloc(sizeof(lz4_blob_t) + sprite_size + sprite_size / 255 + 16);
+    uint32_t blob_size = lz4_compress_test(blob, __sprite16.buffer, sprite_size);
+    surface_t loaded = surface_load_lz4(__sprite16.width, __sprite16.height, __sprite16.format, blob, blob_size);
+    CHECK((loaded.buffer != NULL) && (memcmp(loaded.buffer, __sprite16.buffer, sprite_size) == 0));
+    CHECK(!data_cache_range_resident(loaded.buffer, sprite_size));
+    surface_free(loaded);
+    free(blob);
+
+    printf("lz4: %s\n", failures ? "checks failed" : "checks passed");
+
+    return failures;
+}
+
+/** @brief Check the surface fences of rdp.c, see rdpcheck.c. */
+int check_rdp(void);
+
+/** @brief Check buffer rotation, frame pacing counters and dirty rectangles of display.c. */
+static int check_display(void)
+{
+    int failures = 0;
+
+    display_init(64, 48, FMT_RGBA16, 3, PRESENT_VSYNC, FILTER_NONE);
+    CHECK(host_interrupt_depth() == 0);
+
+    surface_t* first = display_try_get();
+    surface_t* second = display_try_get();
+    CHECK((first != NULL) && (second != NULL) && (first != second));
+    // One buffer is on screen, the other two are acquired.
+    CHECK(display_try_get() == NULL);
+
+    // Nothing is pending, the vblank must keep showing the same buffer.
+    uint32_t origin = host_vi_origin();
+    host_vblank();
+    CHECK(host_vi_origin() == origin);
+
+    display_show(second);
+    display_show(first);
+    host_vblank();
+    CHECK(host_vi_origin() == (uint32_t) (uintptr_t) first->buffer);
+    host_vblank();
+    CHECK(host_vi_origin() == (uint32_t) (uintptr_t) second->buffer);
+    host_vblank();
+    CHECK(host_vi_origin() == (uint32_t) (uintptr_t) second->buffer);
+
+    display_stats_t stats;
+    display_get_stats(&stats);
+    CHECK(stats.presented == 2);
+    CHECK(stats.repeated == 1);
+    CHECK(stats.vblanks == 4);
+    CHECK(stats.acquired == 2);
+
+    // The buffer shown before the flip is free again.
+    surface_t* third = display_try_get();
+    CHECK((third != NULL) && (third != second));
+
+    display_rect_t rects[DISPLAY_MAX_DIRTY_RECTS];
+    CHECK(display_take_dirty(third, rects) == -1);
+    display_mark_dirty(third, 0, 0, 8, 8);
+    display_mark_dirty(third, 4, 4, 12, 12);
+    display_mark_dirty(third, 30, 30, 40, 40);
+    CHECK(display_take_dirty(third, rects) == 2);
+    CHECK((rects[0].x0 == 0) && (rects[0].y0 == 0) && (rects[0].x1 == 12) && (rects[0].y1 == 12));
+    CHECK(display_take_dirty(third, rects) == 0);
+
+    for (int i = 0; i <= DISPLAY_MAX_DIRTY_RECTS; i++)
+    {
+        display_mark_dirty(third, i * 2, 0, i * 2 + 1, 1);
+    }
+    CHECK(display_take_dirty(third, rects) == -1);
+
+    display_rect_t dummy;
+    surface_t other = surface_alloc(8, 8, FMT_RGBA16);
+    CHECK(display_take_dirty(&other, &dummy) == -1);
+    free(other.buffer);
+
+    arena_t* frame = frame_arena_get();
+    CHECK(frame != NULL);
+    uint32_t* data = arena_alloc(frame, 4 * sizeof(uint32_t));
+    data[0] = 0x12345678;
+    uint32_t mark = arena_mark(frame);
+    CHECK(arena_alloc(frame, 3) != NULL);
+    CHECK(((uintptr_t) arena_alloc(frame, 1) % ARENA_ALIGN) == 0);
+    arena_rollback(frame, mark);
+    CHECK(frame->used == mark);
+    CHECK(arena_alloc(frame, FRAME_ARENA_SIZE) == NULL);
+
+    // The frame just shown keeps its arena data, the one after it gets a fresh arena.
+    display_show(third);
+    CHECK(host_interrupt_depth() == 0);
+    CHECK(frame_arena_get() != frame);
+    CHECK(data[0] == 0x12345678);
+
+    host_vblank();
+    surface_t* fourth = display_try_get();
+    CHECK(fourth != NULL);
+    display_show(fourth);
+    CHECK(frame_arena_get() == frame);
+    CHECK(frame->used == 0);
+
+    printf("display: %s\n", failures ? "checks failed" : "checks passed");
+
+    return failures;
+}
+
+/** @brief Seconds on the host's monotonic clock. */
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+typedef struct bench_s
+{
+    const char* name;
+    void (*run)(surface_t* dst);
+    int pixels;
+} bench_t;
+
+static void bench_fill(surface_t* dst)
+{
+    graphics_fill(dst, RGBA32(10, 20, 30, 255));
+}
+
+static void bench_fill_rect(surface_t* dst)
+{
+    // Odd start and width, to include the unaligned head and tail.
+    graphics_fill_rect(dst, 3, 3, BENCH_WIDTH - 7, BENCH_HEIGHT - 6, RGBA32(10, 20, 30, 255));
+}
+
+static void bench_blit(surface_t* dst)
+{
+    for (int y = 0; y + 32 <= BENCH_HEIGHT; y += 32)
+    {
+        for (int x = 1; x + 32 <= BENCH_WIDTH; x += 32)
+        {
+            graphics_draw_surface(dst, x, y, &__sprite);
+        }
+    }
+}
+
+static void bench_blit_alpha(surface_t* dst)
+{
+    for (int y = 0; y + 32 <= BENCH_HEIGHT; y += 32)
+    {
+        for (int x = 1; x + 32 <= BENCH_WIDTH; x += 32)
+        {
+            graphics_draw_surface_alpha(dst, x, y, &__sprite);
+        }
+    }
+}
+
+/** @brief Time each benchmark on both destination formats and print the throughput. */
+static void run_benchmarks(void)
+{
+    static const surface_format_t formats[] = {FMT_RGBA16, FMT_RGBA32};
+    static const char* format_names[] = {"rgba16", "rgba32"};
+    // The blits cover 9 columns and 7 rows of 32x32 sprites.
+    const bench_t benches[] = {
+        {"fill", bench_fill, BENCH_WIDTH * BENCH_HEIGHT},
+        {"fill_rect", bench_fill_rect, (BENCH_WIDTH - 7) * (BENCH_HEIGHT - 6)},
+        {"blit", bench_blit, 9 * 7 * 32 * 32},
+        {"blit_alpha", bench_blit_alpha, 9 * 7 * 32 * 32},
+    };
+
+    for (int f = 0; f < 2; f++)
+    {
+        surface_t surface = surface_alloc(BENCH_WIDTH, BENCH_HEIGHT, formats[f]);
+        for (int b = 0; b < (int) (sizeof(benches) / sizeof(benches[0])); b++)
+        {
+            // Warm up caches, then repeat until enough time has passed to be measurable.
+            benches[b].run(&surface);
+
+            int iterations = 0;
+            double start = now_seconds();
+            double elapsed;
+            do
+            {
+                for (int i = 0; i < 16; i++)
+                {
+                    benches[b].run(&surface);
+                }
+                iterations += 16;
+                elapsed = now_seconds() - start;
+            } while (elapsed < BENCH_SECONDS);
+
+            double pixels = (double) benches[b].pixels * iterations;
+            printf("bench: %-10s %s %8.1f Mpixel/s %8.2f us/call\n", benches[b].name, format_names[f],
+                   pixels / elapsed * 1e-6, elapsed / iterations * 1e6);
+        }
+        free(surface.buffer);
+    }
+
+    // Decompress a full screen background: a flat color with a row of sprites repeated down the screen.
+    surface_t sprite = surface_alloc(BENCH_WIDTH, BENCH_HEIGHT, FMT_RGBA16);
+    graphics_fill(&sprite, RGBA32(40, 60, 90, 255));
+    for (int y = 0; y < BENCH_HEIGHT; y += 48)
+    {
+        for (int x = 0; x < BENCH_WIDTH; x += 32)
+        {
+            graphics_draw_surface(&sprite, x, y, &__sprite16);
+        }
+    }
+    uint32_t size = surface_buffer_size(sprite.format, sprite.width, sprite.height);
+    uint8_t* blob = malloc(sizeof(lz4_blob_t) + size + size / 255 + 16);
+    uint32_t blob_size = lz4_compress_test(blob, sprite.buffer, size);
+    float mb_per_second = lz4_benchmark(sprite.buffer, blob, blob_size, 200);
+    printf("bench: %-10s %s %8.1f MB/s (%u of %u bytes compressed)\n", "lz4", format_names[0], mb_per_second, blob_size, size);
+    free(blob);
+    free(sprite.buffer);
+}
+
+static void print_usage(void)
+{
+    fprintf(stderr, "Usage: hostgfx [--out DIR] [--golden DIR] [--bench]\n");
+    fprintf(stderr, "  --out DIR      Write rendered scenes to DIR as PPM images.\n");
+    fprintf(stderr, "  --golden DIR   Compare rendered scenes against the PPM images in DIR.\n");
+    fprintf(stderr, "  --bench        Run fill, blit and LZ4 decompression benchmarks.\n");
+}
+
+int main(int argc, char* argv[])
+{
+    const char* out_dir = NULL;
+    const char* golden_dir = NULL;
+    bool bench = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--out") == 0) && (i + 1 < argc))
+        {
+            out_dir = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--golden") == 0) && (i + 1 < argc))
+        {
+            golden_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bench") == 0)
+        {
+            bench = true;
+        }
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if ((out_dir == NULL) && (golden_dir == NULL) && !bench)
+    {
+        print_usage();
+        return 1;
+    }
+
+    __sprite = make_sprite(24, 24, FMT_RGBA32);
+    __sprite16 = make_sprite(24, 24, FMT_RGBA16);
+    __sprite_ci8 = make_sprite_ci(28, 28, FMT_CI8, __palette8, 256);
+    __sprite_ci4 = make_sprite_ci(27, 25, FMT_CI4, __palette4, 16);
+    __tileset = make_tileset();
+
+    int failures = 0;
+    if ((out_dir != NULL) || (golden_dir != NULL))
+    {
+        failures += run_scenes(out_dir, golden_dir);
+        failures += check_colors();
+        failures += check_uncached();
+        failures += check_lz4();
+        failures += check_regions();
+        failures += check_display();
+        failures += check_rdp();
+    }
+
+    if (bench)
+    {
+        __sprite = make_sprite(32, 32, FMT_RGBA32);
+        run_benchmarks();
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file mock.c
+ * @brief Register-mock layer letting the CPU side of the graphics code run on the host.
+ *
+ * Memory-mapped registers are plain structs, interrupts are only raised on request
+ * (see host.h) and cache maintenance only forgets which memory was accessed through
+ * KSEG0. The RDP reports that it can't draw anything, so every draw call takes the
+ * CPU path.
+ */
+
+#include "system.h"
+#include "memory.h"
+#include "interrupt.h"
+#include "rdp.h"
+#include "vi.h"
+#include "cop0.h"
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** @brief Backing storage of the VI registers, starts out in vertical blank. */
+static VI_registers_t __vi = {.v_current = VI_V_CURRENT_VBLANK};
+volatile VI_registers_t* const VI_regs = &__vi;
+
+/** @brief Nesting depth of interrupt_disable. */
+static int __interrupt_depth = 0;
+/** @brief Whether the VI interrupt is enabled. */
+static bool __vi_interrupt = false;
+/** @brief Number of addresses #host_kseg0 remembers. */
+#define HOST_CACHED_COUNT   (64)
+/** @brief Addresses converted to KSEG0 and not invalidated since, standing in for the data cache. */
+static uintptr_t __cached[HOST_CACHED_COUNT];
+/** @brief Slot of #__cached the next address goes to, the oldest one is forgotten. */
+static int __cached_next = 0;
+/** @brief Last fence handed out by rdp_fence. */
+static uint32_t __rdp_fence = 0;
+
+void __display_callback(void);
+
+void host_vblank(void)
+{
+    if (__vi_interrupt && (__interrupt_depth == 0))
+    {
+        __display_callback();
+    }
+}
+
+uint32_t host_vi_origin(void)
+{
+    return __vi.origin;
+}
+
+int host_interrupt_depth(void)
+{
+    return __interrupt_depth;
+}
+
+uint32_t host_c0_count(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) ((uint64_t) now.tv_sec * 46875000 + (uint64_t) now.tv_nsec * 3 / 64);
+}
+
+void* malloc_uncached(size_t numbytes)
+{
+    // The host allocator already aligns to 16 bytes, same as the data cache lines on the N64.
+    return malloc(numbytes);
+}
+
+void* user_region_alloc(uint32_t size)
+{
+    // There is no user segment on the host, nothing gives this memory back either.
+    return aligned_alloc(16, (size + 15) & ~15);
+}
+
+uintptr_t host_kseg0(uintptr_t addr)
+{
+    __cached[__cached_next] = addr;
+    __cached_next = (__cached_next + 1) % HOST_CACHED_COUNT;
+    return addr;
+}
+
+/** @brief Find a remembered KSEG0 address within a range, or -1. */
+static int host_cached_find(volatile void* addr, unsigned long length)
+{
+    for (int i = 0; i < HOST_CACHED_COUNT; i++)
+    {
+        if ((__cached[i] != 0) && (__cached[i] >= (uintptr_t) addr) && (__cached[i] < (uintptr_t) addr + length))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/** @brief Forget the KSEG0 accesses within a range, like invalidating its lines. */
+static void host_cached_drop(volatile void* addr, unsigned long length)
+{
+    for (int i = host_cached_find(addr, length); i >= 0; i = host_cached_find(addr, length))
+    {
+        __cached[i] = 0;
+    }
+}
+
+void data_cache_index_writeback_invalidate(volatile void* addr, unsigned long length) { host_cached_drop(addr, length); }
+void data_cache_hit_invalidate(volatile void* addr, unsigned long length) { host_cached_drop(addr, length); }
+void data_cache_hit_writeback_invalidate(volatile void* addr, unsigned long length) { host_cached_drop(addr, length); }
+void data_cache_hit_writeback(volatile void* addr, unsigned long length) {}
+void data_cache_writeback_invalidate_all(void) { memset(__cached, 0, sizeof(__cached)); }
+void data_cache_range_writeback(volatile void* addr, unsigned long length) {}
+void data_cache_range_writeback_invalidate(volatile void* addr, unsigned long length) { host_cached_drop(addr, length); }
+
+bool data_cache_range_resident(volatile void* addr, unsigned long length)
+{
+    return host_cached_find(addr, length) >= 0;
+}
+
+void print(const char* data)
+{
+    fputs(data, stdout);
+}
+
+void println(const char* data)
+{
+    puts(data);
+}
+
+void println_u32(const char* data, uint32_t value)
+{
+    printf("%s%u\n", data, value);
+}
+
+void println_x32(const char* data, uint32_t value)
+{
+    printf("%s0x%08X\n", data, value);
+}
+
+void assert(bool condition, const char* msg)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "assertion failed: %s\n", msg);
+        fflush(NULL);
+        // abort() is the kernel's endless loop in this translation unit.
+        __builtin_trap();
+    }
+}
+
+void interrupt_disable(void)
+{
+    __interrupt_depth++;
+}
+
+void interrupt_enable(void)
+{
+    assert(__interrupt_depth > 0, "interrupt_enable: Interrupts are not disabled.");
+    __interrupt_depth--;
+}
+
+void interrupt_set_VI(bool active, uint32_t line)
+{
+    __vi_interrupt = active;
+    __vi.v_interrupt = line;
+}
+
+bool rdp_can_target(surface_t* surface)
+{
+    return false;
+}
+
+bool rdp_can_texture(surface_t* surface)
+{
+    return false;
+}
+
+void rdp_fill_rectangle(surface_t* dst, int x0, int y0, int x1, int y1, uint32_t color)
+{
+    assert(false, "rdp_fill_rectangle: No RDP on the host.");
+}
+
+void rdp_draw_surface_alpha(surface_t* dst, int x, int y, surface_t* src, int src_x0, int src_y0, int src_x1, int src_y1)
+{
+    assert(false, "rdp_draw_surface_alpha: No RDP on the host.");
+}
+
+void rdp_flush(void) {}
+
+void rdp_wait(void) {}
+
+uint32_t rdp_fence(void)
+{
+    return ++__rdp_fence;
+}
+
+bool rdp_fence_done(uint32_t fence)
+{
+    return true;
+}
+
+void rdp_wait_fence(uint32_t fence) {}
+
+void rdp_wait_surface(surface_t* surface) {}
@@ -0,0 +1,16 @@
+/**
+ * @file cop0.h
+ * @brief Host stand-in for kernel/include/cop0.h, only the Count register is provided.
+ */
+
+#ifndef KIVOS64_COP0_H
+#define KIVOS64_COP0_H
+
+#include "intdef.h"
+
+/** @brief Read the host clock scaled to the 46.875 MHz rate of the COP0 Count register. */
+uint32_t host_c0_count(void);
+
+#define C0_COUNT() host_c0_count()
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * @file host.h
+ * @brief Hooks of the register-mock layer used to drive kernel code on the host.
+ */
+
+#ifndef KIVOS64_HOST_H
+#define KIVOS64_HOST_H
+
+#include "intdef.h"
+
+/**
+ * @brief Raise the VI vertical blank interrupt, if it is enabled.
+ *
+ * Nothing interrupts the host, so anything waiting for a vblank must call this itself.
+ */
+void host_vblank(void);
+
+/** @brief Get the framebuffer address last written to the VI origin register. */
+uint32_t host_vi_origin(void);
+
+/** @brief Get the number of interrupt_disable calls not yet matched by interrupt_enable. */
+int host_interrupt_depth(void);
+
+#endif
@@ -0,0 +1,29 @@
+/**
+ * @file system.h
+ * @brief Host stand-in for kernel/include/system.h.
+ *
+ * Keeps every declaration of the real header, but there are no memory segments
+ * on the host, so converting an address between them leaves it as it is. Converting
+ * to KSEG0 is recorded though, so cached access to uncached memory can be caught.
+ */
+
+#ifndef KIVOS64_HOST_SYSTEM_H
+#define KIVOS64_HOST_SYSTEM_H
+
+#include_next "system.h"
+
+#undef ADDR_TO_PHYS
+#undef ADDR_TO_KSEG0
+#undef ADDR_TO_KSEG1
+#undef ADDR_USER_TO_KERNEL
+
+/** @brief Record that the kernel accesses memory through the cache, see #data_cache_range_resident. */
+uintptr_t host_kseg0(uintptr_t addr);
+
+#define ADDR_TO_PHYS(addr)  (addr)
+#define ADDR_TO_KSEG0(addr) host_kseg0(addr)
+#define ADDR_TO_KSEG1(addr) (addr)
+// Every host address is a kernel address already.
+#define ADDR_USER_TO_KERNEL(addr) (addr)
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * @file rdpcheck.c
+ * @brief Host checks of the batch fence bookkeeping in kernel/src/rdp.c.
+ *
+ * The RDP code is compiled into this file under different names, so it doesn't clash
+ * with the stubs in mock.c that keep the rest of hostgfx on the CPU path. A thread
+ * stands in for the RDP: it finishes every batch written to the DP end register,
+ * after a short delay so that waiting for a batch that was never submitted would
+ * hang instead of passing by accident.
+ */
+
+#define __rdp_callback rdpk_callback
+#define rdp_init rdpk_init
+#define rdp_flush rdpk_flush
+#define rdp_wait rdpk_wait
+#define rdp_fence rdpk_fence
+#define rdp_fence_done rdpk_fence_done
+#define rdp_wait_fence rdpk_wait_fence
+#define rdp_wait_surface rdpk_wait_surface
+#define rdp_can_target rdpk_can_target
+#define rdp_can_texture rdpk_can_texture
+#define rdp_fill_rectangle rdpk_fill_rectangle
+#define rdp_draw_surface_alpha rdpk_draw_surface_alpha
+#include "../../kernel/src/rdp.c"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+/** @brief Backing storage of the DP registers. */
+static DP_registers_t __dp;
+volatile DP_registers_t* const DP_regs = &__dp;
+
+/** @brief Set to stop the RDP thread. */
+static volatile bool __rdp_stop = false;
+
+void interrupt_set_DP(bool active) {}
+
+/** @brief Finish every batch written to the DP registers, a millisecond after it was submitted. */
+static void* rdp_thread(void* arg)
+{
+    uint32_t finished = 0;
+    while (!__rdp_stop)
+    {
+        // The kernel never reads this from another thread, so it isn't volatile there.
+        if (finished != *(volatile uint32_t*) &__rdp_submitted)
+        {
+            nanosleep(&(struct timespec) {.tv_nsec = 1000000}, NULL);
+            finished++;
+            rdpk_callback();
+        }
+    }
+
+    return NULL;
+}
+
+int check_rdp(void)
+{
+    int failures = 0;
+
+    rdpk_init();
+    pthread_t thread;
+    pthread_create(&thread, NULL, rdp_thread, NULL);
+
+    // One more surface than the fence table holds, all in the same batch.
+    surface_t surfaces[RDP_MAX_TRACKED + 1];
+    for (int i = 0; i <= RDP_MAX_TRACKED; i++)
+    {
+        surfaces[i] = surface_alloc(8, 8, FMT_RGBA16);
+        rdpk_fill_rectangle(&surfaces[i], 0, 0, 8, 8, 0xFF0000FF);
+    }
+
+    // Tracking the last one waited out the full table, so its commands are in a newer
+    // batch. Waiting for the surface must send that batch and see it finished.
+    rdpk_wait_surface(&surfaces[RDP_MAX_TRACKED]);
+    if ((__rdp_sent != __rdp_write) || !rdpk_fence_done(__rdp_submitted))
+    {
+        printf("check failed: rdp_wait_surface returned before the RDP was done with the surface\n");
+        failures++;
+    }
+
+    rdpk_wait();
+    __rdp_stop = true;
+    pthread_join(thread, NULL);
+
+    for (int i = 0; i <= RDP_MAX_TRACKED; i++)
+    {
+        surface_free(surfaces[i]);
+    }
+
+    printf("rdp: %s\n", failures ? "checks failed" : "checks passed");
+
+    return failures;
+}
@@ -0,0 +1,653 @@
+/**
+ * @file spriteconv.c
+ * @brief Host tool converting raw RGBA32 images into sprite headers for KIVOS64.
+ *
+ * Input is a headerless file of width * height pixels, 4 bytes per pixel in
+ * R, G, B, A order (for example, what ImageMagick writes for "rgba:out.raw").
+ * Output is a C header with a 16-byte aligned byte array, laid out exactly
+ * like the kernel expects it in memory (big endian).
+ *
+ * Supported output formats:
+ *   rgba32 - Plain pixel array, same as the sprites in kernel/include/game.
+ *   rle    - Run-length encoded rows, see sprite_rle_t in kernel/include/graphics.h.
+ *   ci8    - 8-bit palette indices plus a palette of up to 256 RGBA32 colors (FMT_CI8).
+ *   ci4    - 4-bit palette indices plus a palette of up to 16 RGBA32 colors (FMT_CI4).
+ *
+ * Color-indexed formats need the image to already have few enough colors, quantize
+ * it first if needed (for example with ImageMagick's -colors option).
+ *
+ * Any output can be compressed (--compress) into an LZ4 block, see lz4_blob_t in
+ * kernel/include/lz4.h, and decompressed into a surface on demand with surface_load_lz4.
+ *
+ * An rgba32 or color-indexed image can also be described as a sprite atlas made of a grid of
+ * equally sized frames (--grid), see sprite_atlas_t in kernel/include/sprite.h.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// Must match SURFACE_FLAGS_PREMULTIPLIED in kernel/include/graphics.h.
+#define SURFACE_FLAGS_PREMULTIPLIED     (1 << 0)
+// Must match LZ4_MAGIC in kernel/include/lz4.h.
+#define LZ4_MAGIC                       (0x4C5A344B)
+
+// LZ4 block format limits.
+#define LZ4_MIN_MATCH                   (4)
+#define LZ4_MAX_OFFSET                  (0xFFFF)
+// Matches must start at least 12 bytes and end at least 5 bytes before the end of the data.
+#define LZ4_MATCH_START_MARGIN          (12)
+#define LZ4_MATCH_END_MARGIN            (5)
+#define LZ4_HASH_BITS                   (12)
+
+typedef struct buffer_s
+{
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} buffer_t;
+
+static void buffer_push(buffer_t* buffer, const void* data, size_t size)
+{
+    if (buffer->size + size > buffer->capacity)
+    {
+        buffer->capacity = (buffer->capacity + size) * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+        if (buffer->data == NULL)
+        {
+            fprintf(stderr, "Out of memory.\n");
+            exit(1);
+        }
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void buffer_push_u16(buffer_t* buffer, uint16_t value)
+{
+    uint8_t bytes[2] = {value >> 8, value & 0xFF};
+    buffer_push(buffer, bytes, sizeof(bytes));
+}
+
+static void buffer_push_u32(buffer_t* buffer, uint32_t value)
+{
+    uint8_t bytes[4] = {value >> 24, (value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF};
+    buffer_push(buffer, bytes, sizeof(bytes));
+}
+
+static void buffer_set_u32(buffer_t* buffer, size_t offset, uint32_t value)
+{
+    buffer->data[offset + 0] = value >> 24;
+    buffer->data[offset + 1] = (value >> 16) & 0xFF;
+    buffer->data[offset + 2] = (value >> 8) & 0xFF;
+    buffer->data[offset + 3] = value & 0xFF;
+}
+
+static void buffer_align(buffer_t* buffer, size_t alignment)
+{
+    const uint8_t zero = 0;
+    while (buffer->size % alignment)
+    {
+        buffer_push(buffer, &zero, 1);
+    }
+}
+
+/** @brief Pixels as 32-bit RGBA values, same as RGBA32() in the kernel. */
+static uint32_t* pixels;
+static int width;
+static int height;
+
+static inline uint32_t pixel_at(int x, int y)
+{
+    return pixels[x + y * width];
+}
+
+static void premultiply(void)
+{
+    for (int i = 0; i < width * height; i++)
+    {
+        uint32_t color = pixels[i];
+        uint32_t a = (color & 0xFF) + ((color & 0xFF) >> 7);
+        uint32_t rb = (((color >> 8) & 0x00FF00FF) * a) & 0xFF00FF00;
+        uint32_t g = (((color >> 16) & 0xFF) * a) & 0xFF00;
+        pixels[i] = rb | (g << 8) | (color & 0xFF);
+    }
+}
+
+static void encode_rgba32(buffer_t* out)
+{
+    for (int i = 0; i < width * height; i++)
+    {
+        buffer_push_u32(out, pixels[i]);
+    }
+}
+
+/**
+ * Collect the distinct colors of the image into a palette. All fully transparent
+ * pixels share a single entry.
+ *
+ * @return Number of palette entries or -1 if there are more than max_colors.
+ */
+static int build_palette(uint32_t* palette, int max_colors)
+{
+    int count = 0;
+    for (int i = 0; i < width * height; i++)
+    {
+        uint32_t color = (pixels[i] & 0xFF) ? pixels[i] : 0;
+        int entry = 0;
+        while (entry < count && palette[entry] != color)
+        {
+            entry++;
+        }
+        if (entry == count)
+        {
+            if (count == max_colors)
+            {
+                return -1;
+            }
+            palette[count++] = color;
+        }
+    }
+    return count;
+}
+
+static int palette_index(const uint32_t* palette, int count, uint32_t color)
+{
+    color = (color & 0xFF) ? color : 0;
+    for (int entry = 0; entry < count; entry++)
+    {
+        if (palette[entry] == color)
+        {
+            return entry;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Layout:
+ *   uint8_t indices[]    (ci8: one per pixel, ci4: two per byte, first pixel in the high nibble)
+ * Rows are not padded. The palette goes into a separate array, padded to 16 bytes.
+ */
+static bool encode_ci(buffer_t* out, buffer_t* out_palette, bool ci4)
+{
+    int max_colors = ci4 ? 16 : 256;
+    uint32_t palette[256];
+    int count = build_palette(palette, max_colors);
+    if (count < 0)
+    {
+        fprintf(stderr, "Image has more than %d colors.\n", max_colors);
+        return false;
+    }
+
+    for (int i = 0; i < width * height; i += ci4 ? 2 : 1)
+    {
+        uint8_t value = palette_index(palette, count, pixels[i]);
+        if (ci4)
+        {
+            uint8_t next = (i + 1 < width * height) ? palette_index(palette, count, pixels[i + 1]) : 0;
+            value = (value << 4) | next;
+        }
+        buffer_push(out, &value, 1);
+    }
+    buffer_align(out, 4);
+
+    for (int entry = 0; entry < count; entry++)
+    {
+        buffer_push_u32(out_palette, palette[entry]);
+    }
+    buffer_align(out_palette, 16);
+    return true;
+}
+
+/**
+ * Layout:
+ *   uint16_t width, height
+ *   uint32_t flags
+ *   uint32_t row_offsets[height]     (from start of blob)
+ *   rows, each 4-byte aligned:
+ *     uint16_t span_count
+ *     { uint16_t skip, opaque, blend } spans[span_count]
+ *     (padding to 4 bytes)
+ *     uint32_t pixels[]              (opaque and blend pixels of all spans, in order)
+ */
+static void encode_rle(buffer_t* out, uint32_t flags)
+{
+    buffer_push_u16(out, width);
+    buffer_push_u16(out, height);
+    buffer_push_u32(out, flags);
+
+    size_t offsets_start = out->size;
+    for (int y = 0; y < height; y++)
+    {
+        buffer_push_u32(out, 0);
+    }
+
+    uint16_t* spans = malloc(sizeof(uint16_t) * 3 * (width + 1));
+    uint32_t* row_pixels = malloc(sizeof(uint32_t) * width);
+
+    for (int y = 0; y < height; y++)
+    {
+        int span_count = 0;
+        int pixel_count = 0;
+        int x = 0;
+
+        while (x < width)
+        {
+            int skip = 0, opaque = 0, blend = 0;
+            while (x < width && (pixel_at(x, y) & 0xFF) == 0x00)
+            {
+                skip++;
+                x++;
+            }
+            while (x < width && (pixel_at(x, y) & 0xFF) == 0xFF)
+            {
+                row_pixels[pixel_count++] = pixel_at(x, y);
+                opaque++;
+                x++;
+            }
+            while (x < width && (pixel_at(x, y) & 0xFF) != 0xFF && (pixel_at(x, y) & 0xFF) != 0x00)
+            {
+                row_pixels[pixel_count++] = pixel_at(x, y);
+                blend++;
+                x++;
+            }
+
+            // A trailing transparent run doesn't need a span at all.
+            if (opaque == 0 && blend == 0)
+            {
+                break;
+            }
+
+            spans[span_count * 3 + 0] = skip;
+            spans[span_count * 3 + 1] = opaque;
+            spans[span_count * 3 + 2] = blend;
+            span_count++;
+        }
+
+        buffer_align(out, 4);
+        buffer_set_u32(out, offsets_start + y * 4, out->size);
+
+        buffer_push_u16(out, span_count);
+        for (int i = 0; i < span_count * 3; i++)
+        {
+            buffer_push_u16(out, spans[i]);
+        }
+        buffer_align(out, 4);
+        for (int i = 0; i < pixel_count; i++)
+        {
+            buffer_push_u32(out, row_pixels[i]);
+        }
+    }
+
+    buffer_align(out, 4);
+
+    free(spans);
+    free(row_pixels);
+}
+
+static void lz4_push_length(buffer_t* out, size_t length)
+{
+    const uint8_t max = 255;
+    while (length >= 255)
+    {
+        buffer_push(out, &max, 1);
+        length -= 255;
+    }
+    uint8_t byte = length;
+    buffer_push(out, &byte, 1);
+}
+
+static void lz4_push_sequence(buffer_t* out, const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length)
+{
+    size_t match_code = match_length ? (match_length - LZ4_MIN_MATCH) : 0;
+    uint8_t token = ((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15);
+    buffer_push(out, &token, 1);
+    if (literal_length >= 15)
+    {
+        lz4_push_length(out, literal_length - 15);
+    }
+    buffer_push(out, literals, literal_length);
+
+    // The last sequence has literals only.
+    if (match_length == 0)
+    {
+        return;
+    }
+
+    uint8_t offset_bytes[2] = {offset & 0xFF, offset >> 8};
+    buffer_push(out, offset_bytes, sizeof(offset_bytes));
+    if (match_code >= 15)
+    {
+        lz4_push_length(out, match_code - 15);
+    }
+}
+
+static uint32_t read_u32(const uint8_t* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+/**
+ * Layout:
+ *   uint32_t magic           (LZ4_MAGIC)
+ *   uint32_t size            (decompressed size)
+ *   LZ4 block                (greedy matches found through a hash table of 4-byte sequences)
+ */
+static void lz4_compress(buffer_t* out, const buffer_t* in)
+{
+    const uint8_t* src = in->data;
+    size_t size = in->size;
+
+    buffer_push_u32(out, LZ4_MAGIC);
+    buffer_push_u32(out, size);
+
+    static size_t table[1 << LZ4_HASH_BITS];
+    for (size_t i = 0; i < (1 << LZ4_HASH_BITS); i++)
+    {
+        table[i] = SIZE_MAX;
+    }
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (size > LZ4_MATCH_START_MARGIN && pos < size - LZ4_MATCH_START_MARGIN)
+    {
+        uint32_t sequence = read_u32(src + pos);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+        size_t candidate = table[hash];
+        table[hash] = pos;
+
+        if (candidate == SIZE_MAX || pos - candidate > LZ4_MAX_OFFSET || read_u32(src + candidate) != sequence)
+        {
+            pos++;
+            continue;
+        }
+
+        size_t length = LZ4_MIN_MATCH;
+        while (pos + length < size - LZ4_MATCH_END_MARGIN && src[candidate + length] == src[pos + length])
+        {
+            length++;
+        }
+
+        lz4_push_sequence(out, src + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+
+    lz4_push_sequence(out, src + anchor, size - anchor, 0, 0);
+    buffer_align(out, 4);
+}
+
+/** Decompress the output again and compare, so a compressor bug can't make it into a ROM. */
+static bool lz4_verify(const buffer_t* compressed, const buffer_t* original)
+{
+    const uint8_t* in = compressed->data + 8;
+    const uint8_t* in_end = compressed->data + compressed->size;
+    uint8_t* out = malloc(original->size + 1);
+    size_t out_size = 0;
+
+    while (in < in_end && out_size < original->size)
+    {
+        uint8_t token = *in++;
+        size_t length = token >> 4;
+        if (length == 15)
+        {
+            while (*in == 255)
+            {
+                length += *in++;
+            }
+            length += *in++;
+        }
+        memcpy(out + out_size, in, length);
+        in += length;
+        out_size += length;
+        if (out_size == original->size)
+        {
+            break;
+        }
+
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        length = (token & 0xF) + LZ4_MIN_MATCH;
+        if ((token & 0xF) == 15)
+        {
+            while (*in == 255)
+            {
+                length += *in++;
+            }
+            length += *in++;
+        }
+        for (size_t i = 0; i < length; i++, out_size++)
+        {
+            out[out_size] = out[out_size - offset];
+        }
+    }
+
+    bool ok = (out_size == original->size) && !memcmp(out, original->data, out_size);
+    free(out);
+    return ok;
+}
+
+static void write_header(FILE* file, const char* name, const char* suffix, buffer_t* data)
+{
+    fprintf(file, "unsigned char %s_%s[] __attribute__((aligned(16))) = {", name, suffix);
+    for (size_t i = 0; i < data->size; i++)
+    {
+        fprintf(file, "%s0x%02x,", (i % 12) ? " " : "\n  ", data->data[i]);
+    }
+    fprintf(file, "\n};\n");
+    // Plain pixel arrays are named like the xxd-generated sprites already in the kernel.
+    if (!strcmp(suffix, "data"))
+    {
+        fprintf(file, "unsigned int %s_len = %zu;\n", name, data->size);
+    }
+    else
+    {
+        fprintf(file, "unsigned int %s_%s_len = %zu;\n", name, suffix, data->size);
+    }
+}
+
+static void write_frames(FILE* file, const char* name, int frame_width, int frame_height)
+{
+    int columns = width / frame_width;
+    int rows = height / frame_height;
+
+    fprintf(file, "const sprite_frame_t %s_frames[] = {\n", name);
+    for (int y = 0; y < rows; y++)
+    {
+        for (int x = 0; x < columns; x++)
+        {
+            fprintf(file, "  {%d, %d, %d, %d},\n", x * frame_width, y * frame_height, frame_width, frame_height);
+        }
+    }
+    fprintf(file, "};\n");
+    fprintf(file, "unsigned int %s_frame_count = %d;\n", name, columns * rows);
+}
+
+static void print_usage(const char* prog_name)
+{
+    fprintf(stderr, "Usage: %s [flags] <input.raw> <output.h>\n\n", prog_name);
+    fprintf(stderr, "Converts a raw RGBA32 image (R, G, B, A bytes per pixel) into a sprite header.\n\n");
+    fprintf(stderr, "Flags:\n");
+    fprintf(stderr, "\t-w, --width <width>      Image width in pixels (required).\n");
+    fprintf(stderr, "\t-h, --height <height>    Image height in pixels (required).\n");
+    fprintf(stderr, "\t-n, --name <name>        Name of the C array (default: sprite).\n");
+    fprintf(stderr, "\t-f, --format <format>    Output format: rgba32 (default), rle, ci8 or ci4.\n");
+    fprintf(stderr, "\t-p, --premultiply        Premultiply color by alpha.\n");
+    fprintf(stderr, "\t-z, --compress           Compress the pixel data (LZ4), load it with surface_load_lz4.\n");
+    fprintf(stderr, "\t-g, --grid <w>x<h>       Also emit atlas frames for a grid of w x h pixel frames (not rle).\n");
+}
+
+int main(int argc, char* argv[])
+{
+    const char* name = "sprite";
+    const char* format = "rgba32";
+    const char* input = NULL;
+    const char* output = NULL;
+    bool premultiplied = false;
+    bool compress = false;
+    int frame_width = 0;
+    int frame_height = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = (i + 1 < argc);
+        if ((!strcmp(argv[i], "-w") || !strcmp(argv[i], "--width")) && has_value)
+        {
+            width = atoi(argv[++i]);
+        }
+        else if ((!strcmp(argv[i], "-h") || !strcmp(argv[i], "--height")) && has_value)
+        {
+            height = atoi(argv[++i]);
+        }
+        else if ((!strcmp(argv[i], "-n") || !strcmp(argv[i], "--name")) && has_value)
+        {
+            name = argv[++i];
+        }
+        else if ((!strcmp(argv[i], "-f") || !strcmp(argv[i], "--format")) && has_value)
+        {
+            format = argv[++i];
+        }
+        else if ((!strcmp(argv[i], "-g") || !strcmp(argv[i], "--grid")) && has_value)
+        {
+            if (sscanf(argv[++i], "%dx%d", &frame_width, &frame_height) != 2 || frame_width <= 0 || frame_height <= 0)
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-p") || !strcmp(argv[i], "--premultiply"))
+        {
+            premultiplied = true;
+        }
+        else if (!strcmp(argv[i], "-z") || !strcmp(argv[i], "--compress"))
+        {
+            compress = true;
+        }
+        else if (argv[i][0] == '-')
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+        else if (input == NULL)
+        {
+            input = argv[i];
+        }
+        else if (output == NULL)
+        {
+            output = argv[i];
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (input == NULL || output == NULL || width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(input, "rb");
+    if (in == NULL)
+    {
+        fprintf(stderr, "Cannot open %s.\n", input);
+        return 1;
+    }
+
+    pixels = malloc(sizeof(uint32_t) * width * height);
+    for (int i = 0; i < width * height; i++)
+    {
+        uint8_t rgba[4];
+        if (fread(rgba, 1, 4, in) != 4)
+        {
+            fprintf(stderr, "%s is smaller than %dx%d RGBA32 pixels.\n", input, width, height);
+            return 1;
+        }
+        pixels[i] = ((uint32_t) rgba[0] << 24) | ((uint32_t) rgba[1] << 16) | ((uint32_t) rgba[2] << 8) | rgba[3];
+    }
+    fclose(in);
+
+    if (premultiplied)
+    {
+        premultiply();
+    }
+
+    if (frame_width && (!strcmp(format, "rle") || frame_width > width || frame_height > height))
+    {
+        fprintf(stderr, "A grid needs a non-rle format and frames no larger than the image.\n");
+        return 1;
+    }
+
+    buffer_t data = {0};
+    buffer_t palette = {0};
+    const char* suffix;
+    if (!strcmp(format, "rgba32"))
+    {
+        encode_rgba32(&data);
+        suffix = "data";
+    }
+    else if (!strcmp(format, "rle"))
+    {
+        encode_rle(&data, premultiplied ? SURFACE_FLAGS_PREMULTIPLIED : 0);
+        suffix = "rle";
+    }
+    else if (!strcmp(format, "ci8") || !strcmp(format, "ci4"))
+    {
+        if (!encode_ci(&data, &palette, !strcmp(format, "ci4")))
+        {
+            return 1;
+        }
+        suffix = "data";
+    }
+    else
+    {
+        fprintf(stderr, "Unknown format %s.\n", format);
+        return 1;
+    }
+
+    if (compress)
+    {
+        buffer_t compressed = {0};
+        lz4_compress(&compressed, &data);
+        if (!lz4_verify(&compressed, &data))
+        {
+            fprintf(stderr, "Compression failed to round-trip.\n");
+            return 1;
+        }
+        free(data.data);
+        data = compressed;
+        suffix = "lz4";
+    }
+
+    FILE* out = fopen(output, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Cannot open %s.\n", output);
+        return 1;
+    }
+    write_header(out, name, suffix, &data);
+    if (palette.size)
+    {
+        write_header(out, name, "palette", &palette);
+    }
+    if (frame_width)
+    {
+        write_frames(out, name, frame_width, frame_height);
+    }
+    fclose(out);
+
+    printf("%s: %dx%d %s, %zu bytes (raw: %d bytes)\n", output, width, height, format, data.size + palette.size, width * height * 4);
+
+    free(data.data);
+    free(palette.data);
+    free(pixels);
+    return 0;
+}